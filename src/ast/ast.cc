@@ -1,4 +1,5 @@
 #include "ast/ast.hh"
+#include <algorithm>
 
 auto get_node_type(NodeKind kind) -> NodeType {
     using enum NodeKind;
@@ -21,10 +22,12 @@ auto get_node_type(NodeKind kind) -> NodeType {
     case ParamSelf:
     case ParamSelfRef:
     case RangeFull:
+    case LazyBlock:
         return NoChild;
 
     // Single child
     case BoolNot:
+    case Negate:
     case OptionalType:
     case PointerType:
     case FunctionType:
@@ -33,7 +36,6 @@ auto get_node_type(NodeKind kind) -> NodeType {
     case RangeFrom:
     case Deref:
     case Refer:
-    case TypeCast:
     case ExprStatement:
     case PatternOptionSome:
     case PatternRangeTo:
@@ -68,6 +70,7 @@ auto get_node_type(NodeKind kind) -> NodeType {
     case BoolLtEq:
     case Select:
     case Image:
+    case TypeCast:
     case IndexCall:
     case PatternArm:
     case ConditionArm:
@@ -134,4 +137,215 @@ auto get_node_type(NodeKind kind) -> NodeType {
     default:
         return NoChild;
     }
-}
\ No newline at end of file
+}
+
+auto is_slice_child(NodeType type, usize index) -> bool {
+    using enum NodeType;
+
+    switch (type) {
+    case MultiChildren:
+        return true;
+    case SingleWithMultiChildren:
+    case FunctionDefChildren: // name, params, return type, body
+        return index == 1;
+    case DoubleWithMultiChildren:
+        return index == 2;
+    case TripleWithMultiChildren:
+        return index == 3;
+    default:
+        return false;
+    }
+}
+
+auto Ast::child_slots() const -> std::vector<Slot> {
+    std::vector<Slot> slots(children_.size(), Slot::Node);
+    for (NodeIndex node = 1; node < nodes_.size(); ++node) {
+        NodeType type   = get_node_type(nodes_[node]);
+        NodeIndex start = children_start_[node];
+        for (usize i = 0; i < children_count_[node]; ++i) {
+            NodeIndex child = children_[start + i];
+            if (child != 0 && is_slice_child(type, i)) {
+                slots[start + i] = Slot::Slice;
+                slots[child]     = Slot::Length;
+            }
+        }
+    }
+    return slots;
+}
+
+auto Ast::append(const Ast& other) -> NodeIndex {
+    NodeIndex node_shift  = nodes_.size() - 1;
+    NodeIndex child_shift = children_.size() - 1;
+
+    auto slots            = other.child_slots();
+
+    nodes_.insert(nodes_.end(), other.nodes_.begin() + 1, other.nodes_.end());
+    spans_.insert(spans_.end(), other.spans_.begin() + 1, other.spans_.end());
+    for (NodeIndex node = 1; node < other.nodes_.size(); ++node) {
+        children_start_.push_back(other.children_start_[node] + child_shift);
+        children_count_.push_back(other.children_count_[node]);
+    }
+
+    children_.reserve(children_.size() + other.children_.size() - 1);
+    for (usize i = 1; i < other.children_.size(); ++i) {
+        NodeIndex value = other.children_[i];
+        switch (slots[i]) {
+        case Slot::Node:
+            children_.push_back(value == 0 ? 0 : value + node_shift);
+            break;
+        case Slot::Slice:
+            children_.push_back(value + child_shift);
+            break;
+        case Slot::Length:
+            children_.push_back(value);
+            break;
+        }
+    }
+    return node_shift;
+}
+
+auto Ast::subtree_first(NodeIndex node) const -> std::optional<NodeIndex> {
+    if (node == 0 || node >= nodes_.size()) {
+        return std::nullopt;
+    }
+    NodeIndex first = node;
+    NodeIndex last  = node;
+    usize count     = 0;
+    std::vector<NodeIndex> pending = {node};
+    while (!pending.empty()) {
+        NodeIndex current = pending.back();
+        pending.pop_back();
+        ++count;
+        first = std::min(first, current);
+        last  = std::max(last, current);
+
+        NodeType type = get_node_type(nodes_[current]);
+        auto children = get_children(current);
+        for (usize i = 0; i < children.size(); ++i) {
+            if (children[i] == 0) {
+                continue;
+            }
+            if (!is_slice_child(type, i)) {
+                pending.push_back(children[i]);
+                continue;
+            }
+            auto items = *get_multi_child_slice(children[i]);
+            for (NodeIndex item : items) {
+                if (item != 0) {
+                    pending.push_back(item);
+                }
+            }
+        }
+    }
+    if (last != node || count != node - first + 1) {
+        return std::nullopt;
+    }
+    return first;
+}
+
+auto Ast::splice(NodeIndex first, NodeIndex node, const Ast& fragment)
+    -> NodeIndex {
+    auto slots          = child_slots();
+    auto fragment_slots = fragment.child_slots();
+
+    // The subtree's child slots are contiguous too: its slices come before
+    // the nodes that own them, and the root's own slots come last
+    usize child_last  = children_start_[node] + children_count_[node];
+    usize child_first = child_last;
+    for (NodeIndex current = first; current <= node; ++current) {
+        usize start = children_start_[current];
+        child_first = std::min(child_first, start);
+        for (usize i = 0; i < children_count_[current]; ++i) {
+            if (slots[start + i] == Slot::Slice) {
+                child_first = std::min<usize>(child_first,
+                                              children_[start + i]);
+            }
+        }
+    }
+
+    usize fragment_nodes = fragment.nodes_.size() - 1;
+    NodeIndex new_root   = first + fragment_nodes - 1;
+    i64 node_shift       = static_cast<i64>(fragment_nodes)
+                   - static_cast<i64>(node - first + 1);
+    i64 child_shift = static_cast<i64>(fragment.children_.size() - 1)
+                    - static_cast<i64>(child_last - child_first);
+    auto shift      = [](usize value, i64 amount) -> NodeIndex {
+        return static_cast<NodeIndex>(static_cast<i64>(value) + amount);
+    };
+
+    std::vector<NodeIndex> children(children_.begin(),
+                                    children_.begin() + child_first);
+    children.reserve(shift(children_.size(), child_shift));
+    for (usize i = 1; i < fragment.children_.size(); ++i) {
+        NodeIndex value = fragment.children_[i];
+        switch (fragment_slots[i]) {
+        case Slot::Node:
+            children.push_back(value == 0 ? 0 : value + first - 1);
+            break;
+        case Slot::Slice:
+            children.push_back(value + child_first - 1);
+            break;
+        case Slot::Length:
+            children.push_back(value);
+            break;
+        }
+    }
+    for (usize i = child_last; i < children_.size(); ++i) {
+        NodeIndex value = children_[i];
+        switch (slots[i]) {
+        case Slot::Node:
+            if (value == node) {
+                value = new_root;
+            } else if (value > node) {
+                value = shift(value, node_shift);
+            } else if (value >= first) {
+                value = 0; // unreachable slot into the removed subtree
+            }
+            break;
+        case Slot::Slice:
+            if (value >= child_last) {
+                value = shift(value, child_shift);
+            }
+            break;
+        case Slot::Length:
+            break;
+        }
+        children.push_back(value);
+    }
+    children_ = std::move(children);
+
+    auto splice_nodes = [&](auto& values, const auto& inserted, auto map) {
+        auto tail = std::vector(values.begin() + node + 1, values.end());
+        values.resize(first);
+        for (usize i = 1; i < inserted.size(); ++i) {
+            values.push_back(map(inserted[i], true));
+        }
+        for (const auto& value : tail) {
+            values.push_back(map(value, false));
+        }
+    };
+    auto keep = [](auto value, bool) { return value; };
+    splice_nodes(nodes_, fragment.nodes_, keep);
+    splice_nodes(spans_, fragment.spans_, keep);
+    splice_nodes(children_count_, fragment.children_count_, keep);
+    splice_nodes(children_start_,
+                 fragment.children_start_,
+                 [&](NodeIndex start, bool inserted) -> NodeIndex {
+                     return inserted ? start + child_first - 1
+                                     : shift(start, child_shift);
+                 });
+    // Earlier nodes rewritten by replace_node keep their slots at the end
+    for (NodeIndex current = 1; current < first; ++current) {
+        if (children_start_[current] >= child_last) {
+            children_start_[current] =
+                shift(children_start_[current], child_shift);
+        }
+    }
+
+    if (root_ == node) {
+        root_ = new_root;
+    } else if (root_ > node) {
+        root_ = shift(root_, node_shift);
+    }
+    return new_root;
+}
@@ -7,6 +7,7 @@
 #include <span>
 #include <optional>
 #include <variant>
+#include <initializer_list>
 
 // Node index type, for future extensibility
 using NodeIndex = u32;
@@ -32,6 +33,7 @@ enum class NodeKind : u32 {
 
     // Unary operations
     BoolNot,
+    Negate,
     SelfLower,
     SelfCap,
     Null,
@@ -143,6 +145,8 @@ enum class NodeKind : u32 {
     ParamSelfRef,
 
     Block,
+    /// Function body recorded but not yet parsed; its span covers `{...}`
+    LazyBlock,
 
     // Others
     FileScope,
@@ -267,6 +271,9 @@ class Ast {
     std::vector<NodeKind> nodes_;
     std::vector<Span> spans_;
     std::vector<NodeIndex> children_start_;
+    // Direct children per node. The next node's start is not an end: its
+    // multi-children slices are stored in front of it
+    std::vector<NodeIndex> children_count_;
 
     // Flattened children storage
     std::vector<NodeIndex> children_;
@@ -274,50 +281,96 @@ class Ast {
     NodeIndex root_;
 
   public:
-    Ast() : root_(0) {
+    Ast() : Ast(0, 0) {
+    }
+
+    /// Empty tree with room for `nodes` nodes and `children` child slots
+    /// besides the reserved ones, allocated before anything is stored
+    Ast(usize nodes, usize children) : root_(0) {
+        reserve(nodes + 1, children + 1);
         // Initialize with invalid node at index 0
         nodes_.push_back(NodeKind::Invalid);
         spans_.push_back(Span());
         children_start_.push_back(0);
+        children_count_.push_back(0);
         children_.push_back(0); // Invalid child index
     }
 
+    /// Reserve room for `nodes` more nodes and `children` more child slots
+    auto reserve(usize nodes, usize children) -> void {
+        nodes_.reserve(nodes_.size() + nodes);
+        spans_.reserve(spans_.size() + nodes);
+        children_start_.reserve(children_start_.size() + nodes);
+        children_count_.reserve(children_count_.size() + nodes);
+        children_.reserve(children_.size() + children);
+    }
+
+    /// Store a multi-children slice and return the index to pass as the
+    /// node's child (see get_multi_child_slice)
+    auto add_slice(std::span<const NodeIndex> items) -> NodeIndex {
+        NodeIndex len_index = children_.size();
+        children_.push_back(items.size());
+        children_.insert(children_.end(), items.begin(), items.end());
+        return len_index;
+    }
+
+    /// Add a node, writing its children straight into the flattened
+    /// storage; a multi-children child is the index from add_slice.
+    /// Allocates nothing beyond the amortized growth of the arrays
+    auto add_node(NodeKind kind,
+                  Span span,
+                  std::initializer_list<NodeIndex> children = {})
+        -> NodeIndex {
+        NodeIndex node_index = nodes_.size();
+        nodes_.push_back(kind);
+        spans_.push_back(span);
+        children_start_.push_back(children_.size());
+        children_count_.push_back(children.size());
+        children_.insert(children_.end(), children.begin(), children.end());
+        return node_index;
+    }
+
     /// Add a node to the AST
     auto add_node(const NodeBuilder& builder) -> NodeIndex {
-        // Process children
-        std::vector<NodeIndex> child_indices;
+        // Slices go first, back to back, so the second pass can recompute
+        // where each one starts
+        NodeIndex slice = children_.size();
         for (const auto& child : builder.children()) {
-            if (child.is_single()) {
-                child_indices.push_back(child.as_single());
-            } else {
-                // Store multiple children: first the count,
-                // then the indices
-                NodeIndex len_index  = children_.size();
-                const auto& multiple = child.as_multiple();
-                children_.push_back(multiple.size());
-                for (auto idx : multiple) {
-                    children_.push_back(idx);
-                }
-                child_indices.push_back(len_index);
+            if (child.is_multiple()) {
+                add_slice(child.as_multiple());
             }
         }
 
-        NodeIndex node_index         = nodes_.size();
-        NodeIndex children_start_pos = children_.size();
-
-        // Add child indices to flattened storage
-        children_.insert(children_.end(),
-                         child_indices.begin(),
-                         child_indices.end());
-
-        // Add node data
+        NodeIndex node_index = nodes_.size();
         nodes_.push_back(builder.kind());
         spans_.push_back(builder.span());
-        children_start_.push_back(children_start_pos);
+        children_start_.push_back(children_.size());
+        children_count_.push_back(builder.children().size());
 
+        for (const auto& child : builder.children()) {
+            if (child.is_single()) {
+                children_.push_back(child.as_single());
+            } else {
+                children_.push_back(slice);
+                slice += 1 + child.as_multiple().size();
+            }
+        }
         return node_index;
     }
 
+    /// Rewrite a node in place, keeping its index so parents stay valid.
+    /// The old children remain in the flattened storage, unreachable
+    auto replace_node(NodeIndex node_index,
+                      NodeKind kind,
+                      Span span,
+                      std::initializer_list<NodeIndex> children = {}) -> void {
+        nodes_[node_index]          = kind;
+        spans_[node_index]          = span;
+        children_start_[node_index] = children_.size();
+        children_count_[node_index] = children.size();
+        children_.insert(children_.end(), children.begin(), children.end());
+    }
+
     /// Get children of a node
     auto get_children(NodeIndex node_index) const
         -> std::span<const NodeIndex> {
@@ -325,13 +378,9 @@ class Ast {
             return {};
         }
 
-        usize start = children_start_[node_index];
-        usize end   = (node_index + 1 < children_start_.size())
-                          ? children_start_[node_index + 1]
-                          : children_.size();
-
-        return std::span<const NodeIndex>(children_.data() + start,
-                                          end - start);
+        return std::span<const NodeIndex>(
+            children_.data() + children_start_[node_index],
+            children_count_[node_index]);
     }
 
     /// Get node kind
@@ -400,9 +449,57 @@ class Ast {
     auto spans() const -> std::span<const Span> {
         return spans_;
     }
+
+    /// Number of slots in the flattened children storage, slice lengths
+    /// included
+    auto child_storage_size() const -> usize {
+        return children_.size();
+    }
+
+    /// Append every node of `other` except its reserved node 0, shifting
+    /// node and slice indices to their new positions. Returns the amount
+    /// added to the node indices of `other`. Appending the fragments of a
+    /// file in order reproduces the layout of parsing it in one go
+    auto append(const Ast& other) -> NodeIndex;
+
+    /// Lowest index in the subtree rooted at `node`, or std::nullopt when
+    /// its nodes are not exactly [first, node]. Parsed subtrees always are;
+    /// replace_node can break that
+    auto subtree_first(NodeIndex node) const -> std::optional<NodeIndex>;
+
+    /// Replace the subtree [first, node] (see subtree_first) and its child
+    /// slots with every node of `fragment`, whose last node is the new
+    /// subtree root. Later nodes and slices move to make room, and
+    /// references to `node` now point at the new root, which is returned.
+    /// Spans are copied as they are
+    auto splice(NodeIndex first, NodeIndex node, const Ast& fragment)
+        -> NodeIndex;
+
+    /// Identical nodes, spans, children layout and root
+    auto operator==(const Ast& other) const -> bool = default;
+
+    /// Replace every span with `map(span)`
+    template <typename F>
+    auto remap_spans(F&& map) -> void {
+        for (Span& span : spans_) {
+            span = map(span);
+        }
+    }
+
+  private:
+    /// What a slot of the flattened children storage holds
+    enum class Slot : u8 { Node, Slice, Length };
+
+    /// Classify every child slot. Slots no node reaches, such as the old
+    /// children of a replaced node, count as node indices
+    auto child_slots() const -> std::vector<Slot>;
 };
 
 /// Get node type classification for a node kind
 auto get_node_type(NodeKind kind) -> NodeType;
 
+/// Whether child `index` of a node of this type is a multi-children slice
+/// (see Ast::add_slice) rather than a node
+auto is_slice_child(NodeType type, usize index) -> bool;
+
 #endif // AST_HH
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "driver/driver.hh"
+#include "lex/lex.hh"
+#include "parallel.hh"
+#include "parse/parse.hh"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <optional>
+
+namespace {
+
+// 单个文件在各阶段之间传递的状态，每个槽位只由一个线程写入
+struct FileSlot {
+    VfsNodeId node;
+    std::optional<FileId> file_id;    // 已登记到 SourceMap 的文件
+    std::optional<SourceFile> loaded; // 读取后尚未登记的文件
+    std::unique_ptr<Ast> ast;
+    TokenFingerprint fingerprint{};
+    std::vector<ParseError> errors;
+    // Vfs 中已有的 AST。current 表示它由当前源文件生成，无需处理；
+    // 否则源文件已重新加载，指纹不变时平移跨度后沿用
+    Ast* old_ast = nullptr;
+    std::optional<FileId> old_file_id;
+    std::optional<TokenFingerprint> old_fingerprint;
+    bool current = false;
+    bool reused  = false;
+};
+
+auto read_file(const std::filesystem::path& path) -> std::optional<String> {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    return String((std::istreambuf_iterator<char>(file)),
+                  std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+auto parse_project(Vfs& vfs,
+                   SourceMap& source_map,
+                   DiagCtxt& diag_ctx,
+                   const ParseProjectOptions& options) -> ParseProjectReport {
+    ParseProjectReport report;
+    usize threads = worker_count(options.threads);
+
+    auto nodes = vfs.source_files();
+    std::vector<FileSlot> slots;
+    slots.reserve(nodes.size());
+    for (VfsNodeId node : nodes) {
+        FileSlot& slot = slots.emplace_back();
+        slot.node      = node;
+        slot.file_id   = vfs.get_source_file_id(node);
+        slot.old_ast   = vfs.get_ast_mut(node).value_or(nullptr);
+        if (slot.old_ast) {
+            slot.old_file_id     = vfs.get_ast_file_id(node);
+            slot.old_fingerprint = vfs.get_fingerprint(node);
+        }
+        slot.current
+            = slot.old_ast && slot.file_id && slot.old_file_id == slot.file_id;
+    }
+    report.files = slots.size();
+
+    // 1. 并行读取尚未加载的文件。复制文本、计算行首表和 UTF-8 校验
+    //    都在 SourceFile 构造中完成，起始偏移留到登记时再分配
+    const Vfs& project = vfs;
+    parallel_for(slots.size(), threads, [&](usize i) {
+        FileSlot& slot = slots[i];
+        if (slot.file_id) {
+            return;
+        }
+        auto path = project.get_absolute_path(slot.node);
+        if (!path) {
+            return;
+        }
+        if (auto content = read_file(*path)) {
+            slot.loaded.emplace(path->string(), std::move(*content), 0);
+        }
+    });
+
+    // 2. 按文件顺序登记，全局偏移因此是确定的。此后 SourceMap 不再变动，
+    //    工作线程可以安全地只读访问
+    for (FileSlot& slot : slots) {
+        if (slot.loaded) {
+            slot.file_id = source_map.add_file(std::move(*slot.loaded));
+            slot.loaded.reset();
+            vfs.set_source_file_id(slot.node, *slot.file_id);
+        } else if (!slot.file_id) {
+            report.unreadable.push_back(slot.node);
+        }
+    }
+
+    // 3. 并行词法分析与解析，跳过 AST 仍然有效的文件。源文件重新加载后
+    //    token 指纹不变的文件只改动了空白和注释，已有 AST 平移跨度后沿用，
+    //    不再解析。大文件先分发，避免最后只剩一个线程在处理最大的文件
+    std::vector<usize> order(slots.size());
+    std::iota(order.begin(), order.end(), usize{0});
+    auto size_of = [&](usize i) -> usize {
+        const FileSlot& slot = slots[i];
+        if (!slot.file_id || slot.current) {
+            return usize{0};
+        }
+        return source_map.get_file(*slot.file_id)->content.size();
+    };
+    std::ranges::stable_sort(order, std::greater<>{}, size_of);
+
+    // 每个工作线程一个 ParseContext，token 数组和解析器的暂存栈在文件之间
+    // 复用，AST 按上一个文件的比例预留容量
+    std::vector<ParseContext> contexts;
+    contexts.reserve(threads);
+    for (usize t = 0; t < threads; ++t) {
+        contexts.emplace_back(&source_map);
+        contexts.back().set_lazy_bodies(options.lazy_bodies);
+    }
+
+    parallel_for_workers(order.size(), threads, [&](usize worker, usize i) {
+        FileSlot& slot = slots[order[i]];
+        if (!slot.file_id || slot.current) {
+            return;
+        }
+        const SourceFile* file    = source_map.get_file(*slot.file_id);
+        ParseContext& context     = contexts[worker];
+        const TokenBuffer& tokens = context.lex(file->content);
+        slot.fingerprint          = fingerprint_tokens(tokens);
+
+        if (slot.old_ast && slot.old_file_id
+            && slot.old_fingerprint == slot.fingerprint) {
+            const SourceFile* old = source_map.get_file(*slot.old_file_id);
+            remap_ast_spans(*slot.old_ast,
+                            Lexer(old->content).tokenize_all(),
+                            tokens,
+                            old->start_pos,
+                            file->start_pos);
+            slot.reused = true;
+            return;
+        }
+
+        auto ast = context.parse(file->start_pos);
+        if (!ast) {
+            slot.errors = std::move(ast.error());
+            return;
+        }
+        slot.ast = std::make_unique<Ast>(std::move(*ast));
+    });
+
+    // 4. 写回 Vfs 并按文件顺序发射诊断
+    for (FileSlot& slot : slots) {
+        if (!slot.file_id) {
+            continue;
+        }
+        if (slot.current) {
+            ++report.reused;
+            continue;
+        }
+        report.bytes += source_map.get_file(*slot.file_id)->content.size();
+        if (!slot.errors.empty()) {
+            for (const ParseError& error : slot.errors) {
+                error.emit(diag_ctx);
+            }
+            report.failed.push_back(slot.node);
+            continue;
+        }
+        if (slot.reused) {
+            // 同一个 AST 重新写回，记下新的源文件
+            vfs.set_ast(slot.node, vfs.take_ast(slot.node), slot.fingerprint);
+            ++report.reused;
+            continue;
+        }
+        vfs.set_ast(slot.node, std::move(slot.ast), slot.fingerprint);
+        ++report.parsed;
+    }
+
+    return report;
+}
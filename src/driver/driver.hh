@@ -1,4 +1,45 @@
 #ifndef DRIVER_HH
 #define DRIVER_HH
 
-#endif
\ No newline at end of file
+#include "common.hh"
+#include "diag/diag.hh"
+#include "source_map/source_map.hh"
+#include "vfs/vfs.hh"
+#include <vector>
+
+// 项目解析选项
+struct ParseProjectOptions {
+    // 工作线程数，0 表示每个硬件线程一个
+    usize threads    = 0;
+    // 函数体只记录跨度，需要时用 expand_function_body 展开。
+    // 只关心签名的遍历（模块图、符号索引、补全）可以开启
+    bool lazy_bodies = false;
+};
+
+// 项目解析结果
+struct ParseProjectReport {
+    usize files  = 0; // Beleg 源文件总数
+    usize parsed = 0; // 解析成功并写回 AST 的文件数
+    usize reused = 0; // 沿用已有 AST、未重新解析的文件数
+    usize bytes  = 0; // 参与词法分析的源码字节数
+    std::vector<VfsNodeId> unreadable; // 无法读取的文件
+    std::vector<VfsNodeId> failed;     // 有解析错误的文件
+};
+
+// 加载、词法分析并解析项目中所有 Beleg 源文件。
+//
+// 每个文件在工作线程上拥有独立的 Lexer、Parser 和 Ast，互不共享可变状态；
+// SourceMap 的登记、写回 Vfs 以及诊断发射都在调用线程上按文件顺序进行，
+// 结果与线程数无关。已有 source_file_id 的文件不会重新读取，
+// AST 由当前源文件生成的文件也不再词法分析和解析。
+// 源文件换过（set_source_file_id 指向新内容）而 token 指纹不变的文件
+// 沿用原有 AST，只把跨度平移到新文件。
+// 解析成功的文件写入 AST 与 token 指纹，失败的文件保留原有 AST，
+// 并发射该文件的全部语法错误
+auto parse_project(Vfs& vfs,
+                   SourceMap& source_map,
+                   DiagCtxt& diag_ctx,
+                   const ParseProjectOptions& options = {})
+    -> ParseProjectReport;
+
+#endif // DRIVER_HH
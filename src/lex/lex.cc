@@ -1,4 +1,10 @@
 #include "lex/lex.hh"
+#include "lex/unicode_xid.hh"
+#include "parallel.hh"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
 
 auto lexeme(TokenKind kind) -> std::string_view {
 
@@ -108,143 +114,650 @@ auto lexeme(TokenKind kind) -> std::string_view {
     return "<unknown>";
 }
 
-auto Lexer::next() -> Token {
-    // Skip whitespace
-    while (cursor < src.size() && std::isspace(src[cursor])) {
-        cursor++;
+namespace {
+
+// What the lexer does when a token starts with a given byte.
+enum class ByteClass : u8 {
+    Invalid,
+    Nul,  // the end-of-input sentinel, or a stray NUL byte
+    Utf8, // lead byte of a multi-byte UTF-8 sequence
+    Operator,
+    Ident,
+    Digit,
+    Str,
+    Char,
+};
+
+struct OperatorSpelling {
+    std::string_view text;
+    TokenKind kind;
+};
+
+constexpr OperatorSpelling OPERATORS[] = {
+    {"+", TokenKind::Plus},       {"+=", TokenKind::PlusEq},
+    {"++", TokenKind::PlusPlus},  {"<", TokenKind::Lt},
+    {"<=", TokenKind::LtEq},      {">", TokenKind::Gt},
+    {">=", TokenKind::GtEq},      {"!", TokenKind::Bang},
+    {"!=", TokenKind::BangEq},    {"-", TokenKind::Minus},
+    {"->", TokenKind::Arrow},     {"-=", TokenKind::MinusEq},
+    {".", TokenKind::Dot},        {":", TokenKind::Colon},
+    {"*", TokenKind::Star},       {"*=", TokenKind::StarEq},
+    {"/", TokenKind::Slash},      {"/=", TokenKind::SlashEq},
+    {"%", TokenKind::Percent},    {"%=", TokenKind::PercentEq},
+    {"=", TokenKind::Eq},         {"=>", TokenKind::FatArrow},
+    {"==", TokenKind::EqEq},      {"~", TokenKind::Tilde},
+    {"|", TokenKind::Pipe},       {"#", TokenKind::Hash},
+    {"?", TokenKind::Question},   {"\\", TokenKind::Backslash},
+    {"&", TokenKind::Ampersand},  {"[", TokenKind::LBracket},
+    {"]", TokenKind::RBracket},   {"(", TokenKind::LParen},
+    {")", TokenKind::RParen},     {"{", TokenKind::LBrace},
+    {"}", TokenKind::RBrace},     {",", TokenKind::Comma},
+    {";", TokenKind::Semi},       {"^", TokenKind::Caret},
+    {"$", TokenKind::Dollar},     {"@", TokenKind::At},
+};
+
+// Per-byte dispatch entry. For operator bytes, `single` is the one-byte
+// token and `row` selects the DFA row for a possible second byte (0 if the
+// operator never extends).
+struct ByteInfo {
+    ByteClass cls;
+    TokenKind single;
+    u8 row;
+};
+
+// The operator DFA has one row per first byte that can extend and one column
+// per distinct second byte; column 0 is "any other byte". A cell holds the
+// two-byte token, or TokenKind::Invalid if there is no transition.
+constexpr usize OP_ROWS    = 16;
+constexpr usize OP_COLUMNS = 8;
+
+struct LexTables {
+    std::array<ByteInfo, 256> bytes{};
+    std::array<u8, 256> second{};
+    std::array<std::array<TokenKind, OP_COLUMNS>, OP_ROWS> pairs{};
+};
+
+constexpr auto build_lex_tables() -> LexTables {
+    LexTables t;
+    for (auto& info : t.bytes) {
+        info = {ByteClass::Invalid, TokenKind::Invalid, 0};
+    }
+    for (auto& row : t.pairs) {
+        row.fill(TokenKind::Invalid);
     }
 
-    std::optional<char> ch = current_char();
+    for (usize b = 0; b < 256; ++b) {
+        char c = static_cast<char>(b);
+        if (is_ident_start(c)) {
+            t.bytes[b].cls = ByteClass::Ident;
+        } else if (is_ascii_digit(c)) {
+            t.bytes[b].cls = ByteClass::Digit;
+        }
+    }
+    for (usize b = 0xC2; b <= 0xF4; ++b) {
+        t.bytes[b].cls = ByteClass::Utf8;
+    }
+    t.bytes[0].cls                     = ByteClass::Nul;
+    t.bytes[static_cast<u8>('"')].cls  = ByteClass::Str;
+    t.bytes[static_cast<u8>('\'')].cls = ByteClass::Char;
 
-    if (!ch) {
-        return Token(TokenKind::Eof, cursor, cursor);
+    usize rows = 1, columns = 1;
+    for (const auto& op : OPERATORS) {
+        auto& info = t.bytes[static_cast<u8>(op.text[0])];
+        info.cls   = ByteClass::Operator;
+        if (op.text.size() == 1) {
+            info.single = op.kind;
+            continue;
+        }
+        if (info.row == 0) {
+            info.row = static_cast<u8>(rows++);
+        }
+        auto& column = t.second[static_cast<u8>(op.text[1])];
+        if (column == 0) {
+            column = static_cast<u8>(columns++);
+        }
+        // at() throws past OP_ROWS x OP_COLUMNS, which fails the build
+        t.pairs.at(info.row).at(column) = op.kind;
     }
+    return t;
+}
 
-    Token token = Token(TokenKind::Invalid, cursor, cursor);
-    switch (*ch) {
-#define SINGLE_TOKEN(kind, char)                                               \
-    case char:                                                                 \
-        token = Token(TokenKind::kind, cursor, cursor + 1);                    \
-        break;
+constexpr LexTables LEX_TABLES = build_lex_tables();
 
-        SINGLE_TOKEN(Dot, '.')
-        SINGLE_TOKEN(Colon, ':')
-        SINGLE_TOKEN(Semi, ';')
-        SINGLE_TOKEN(Comma, ',')
-        SINGLE_TOKEN(LParen, '(')
-        SINGLE_TOKEN(RParen, ')')
-        SINGLE_TOKEN(LBrace, '{')
-        SINGLE_TOKEN(RBrace, '}')
-        SINGLE_TOKEN(LBracket, '[')
-        SINGLE_TOKEN(RBracket, ']')
-        SINGLE_TOKEN(Tilde, '~')
-        SINGLE_TOKEN(Pipe, '|')
-        SINGLE_TOKEN(Hash, '#')
-        SINGLE_TOKEN(Question, '?')
-        SINGLE_TOKEN(Backslash, '\\')
-        SINGLE_TOKEN(Ampersand, '&')
-        SINGLE_TOKEN(Caret, '^')
-        SINGLE_TOKEN(Dollar, '$')
-        SINGLE_TOKEN(At, '@')
-#undef SINGLE_TOKEN
-
-    case '+':
-        if (peek("+=")) {
-            token = Token(TokenKind::PlusEq, cursor, cursor + 2);
-        } else if (peek("++")) {
-            token = Token(TokenKind::PlusPlus, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Plus, cursor, cursor + 1);
+} // namespace
+
+auto fixed_token_length(TokenKind kind) -> std::optional<u32> {
+    switch (kind) {
+    case TokenKind::Id:
+    case TokenKind::Str:
+    case TokenKind::Int:
+    case TokenKind::IntBin:
+    case TokenKind::IntOct:
+    case TokenKind::IntHex:
+    case TokenKind::Real:
+    case TokenKind::RealSci:
+    case TokenKind::Char:
+    case TokenKind::Comment:
+    case TokenKind::Invalid:
+        return std::nullopt;
+    case TokenKind::Sof:
+    case TokenKind::Eof:
+        return 0;
+    default:
+        return static_cast<u32>(lexeme(kind).size());
+    }
+}
+
+auto TokenBuffer::compact_end(usize index) const -> u32 {
+    u32 start = this->start(index);
+    if (auto length = fixed_token_length(kind(index))) {
+        return start + *length;
+    }
+
+    Lexer lexer(src_, Lexer::InPlace{});
+    lexer.cursor = start;
+    return lexer.next().end;
+}
+
+namespace {
+
+// Adds `shift` to offsets [first, last) of an array
+auto shift_offsets(std::vector<u32>& offsets,
+                   usize first,
+                   usize last,
+                   i64 shift) -> void {
+    if (shift == 0) {
+        return;
+    }
+    for (usize i = first; i < last; ++i) {
+        offsets[i] = static_cast<u32>(offsets[i] + shift);
+    }
+}
+
+} // namespace
+
+auto TokenBuffer::copy_range(TokenBuffer& into, usize first, usize last) const
+    -> void {
+    // Slots [from, to) hold the tokens, `shift` bytes short
+    auto copy = [&](usize from, usize to, i64 shift) {
+        usize at = into.starts_.size();
+        into.kinds_.insert(into.kinds_.end(),
+                           kinds_.begin() + from,
+                           kinds_.begin() + to);
+        into.starts_.insert(into.starts_.end(),
+                            starts_.begin() + from,
+                            starts_.begin() + to);
+        shift_offsets(into.starts_, at, into.starts_.size(), shift);
+        if (into.storage_ == TokenStorage::Full) {
+            into.ends_.insert(into.ends_.end(),
+                              ends_.begin() + from,
+                              ends_.begin() + to);
+            shift_offsets(into.ends_, at, into.ends_.size(), shift);
         }
-        break;
+    };
 
-    case '-':
-        if (peek("->")) {
-            token = Token(TokenKind::Arrow, cursor, cursor + 2);
-        } else if (peek("-=")) {
-            token = Token(TokenKind::MinusEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Minus, cursor, cursor + 1);
+    usize split = std::clamp(gap_, first, last);
+    copy(first, split, 0);
+    copy(split + gap_len_, last + gap_len_, shift_);
+}
+
+auto TokenBuffer::append(const TokenBuffer& other, usize first) -> void {
+    close_gap();
+    other.copy_range(*this, first, other.size());
+}
+
+auto TokenBuffer::move_gap(usize index) -> void {
+    if (gap_len_ == 0 && shift_ == 0) {
+        gap_ = index;
+        return;
+    }
+
+    bool full = storage_ == TokenStorage::Full;
+    if (index < gap_) {
+        // [index, gap_) moves behind the gap and takes on the pending shift
+        for (usize i = gap_; i-- > index;) {
+            kinds_[i + gap_len_]  = kinds_[i];
+            starts_[i + gap_len_] = static_cast<u32>(starts_[i] - shift_);
+            if (full) {
+                ends_[i + gap_len_] = static_cast<u32>(ends_[i] - shift_);
+            }
         }
-        break;
+    } else {
+        // The tokens up to index move in front of the gap, shift applied
+        for (usize i = gap_; i < index; ++i) {
+            kinds_[i]  = kinds_[i + gap_len_];
+            starts_[i] = static_cast<u32>(starts_[i + gap_len_] + shift_);
+            if (full) {
+                ends_[i] = static_cast<u32>(ends_[i + gap_len_] + shift_);
+            }
+        }
+    }
+    gap_ = index;
+}
 
-    case '*':
-        if (peek("*=")) {
-            token = Token(TokenKind::StarEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Star, cursor, cursor + 1);
+auto TokenBuffer::close_gap() -> void {
+    if (gap_len_ == 0 && shift_ == 0) {
+        return;
+    }
+
+    usize count = size();
+    move_gap(count);
+    kinds_.resize(count);
+    starts_.resize(count);
+    if (storage_ == TokenStorage::Full) {
+        ends_.resize(count);
+    }
+    gap_len_ = 0;
+    shift_   = 0;
+}
+
+auto TokenBuffer::splice(usize first,
+                         usize last,
+                         const TokenBuffer& replacement,
+                         i64 shift) -> void {
+    // The replaced tokens join the gap
+    move_gap(last);
+    gap_ = first;
+    gap_len_ += last - first;
+
+    usize count = replacement.size();
+    if (count > gap_len_) {
+        usize grow = std::max(count - gap_len_, size() / 8 + 64);
+        usize at   = gap_ + gap_len_;
+        kinds_.insert(kinds_.begin() + at, grow, TokenKind::Eof);
+        starts_.insert(starts_.begin() + at, grow, 0);
+        if (storage_ == TokenStorage::Full) {
+            ends_.insert(ends_.begin() + at, grow, 0);
         }
-        break;
+        gap_len_ += grow;
+    }
 
-    case '/':
-        if (peek("/=")) {
-            token = Token(TokenKind::SlashEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Slash, cursor, cursor + 1);
+    // Written in front of the gap with their final offsets
+    for (usize i = 0; i < count; ++i) {
+        kinds_[gap_ + i]  = replacement.kind(i);
+        starts_[gap_ + i] = replacement.start(i);
+    }
+    if (storage_ == TokenStorage::Full) {
+        for (usize i = 0; i < count; ++i) {
+            ends_[gap_ + i] = replacement.end(i);
         }
-        break;
+    }
+    gap_ += count;
+    gap_len_ -= count;
+    shift_ += shift;
+}
+
+auto TokenBuffer::drop_front(usize count) -> void {
+    close_gap();
+    kinds_.erase(kinds_.begin(), kinds_.begin() + count);
+    starts_.erase(starts_.begin(), starts_.begin() + count);
+    if (storage_ == TokenStorage::Full) {
+        ends_.erase(ends_.begin(), ends_.begin() + count);
+    }
+}
+
+auto TokenBuffer::slice(usize first, usize last) const -> TokenBuffer {
+    TokenBuffer out(src_, storage_, owner_);
+    out.reserve(last - first + 1);
+    copy_range(out, first, last);
+    u32 end = start(last);
+    out.push(Token(TokenKind::Eof, end, end));
+    return out;
+}
 
-    case '%':
-        if (peek("%=")) {
-            token = Token(TokenKind::PercentEq, cursor, cursor + 2);
+auto TokenBuffer::lower_bound_start(u32 pos, usize from) const -> usize {
+    usize count = size();
+    while (from < count) {
+        usize mid = from + (count - from) / 2;
+        if (start(mid) < pos) {
+            from = mid + 1;
         } else {
-            token = Token(TokenKind::Percent, cursor, cursor + 1);
+            count = mid;
         }
-        break;
+    }
+    return from;
+}
 
-    case '<':
-        if (peek("<=")) {
-            token = Token(TokenKind::LtEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Lt, cursor, cursor + 1);
+auto TokenStream::fill(usize index) const -> void {
+    while (lexer_ && index - base_ >= window_.size()) {
+        for (usize i = 0; i < FILL_BATCH; ++i) {
+            Token token = lexer_->next();
+            window_.push(token);
+            if (token.kind == TokenKind::Eof) {
+                lexer_.reset();
+                break;
+            }
         }
-        break;
+    }
+}
 
-    case '>':
-        if (peek(">=")) {
-            token = Token(TokenKind::GtEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Gt, cursor, cursor + 1);
+auto TokenStream::release(usize index) -> void {
+    released_ = std::max(released_, index);
+    usize dead = std::min(released_ - base_, window_.size());
+    // Dropping once half the window is dead keeps the copying amortized
+    if (dead >= DROP_THRESHOLD && dead * 2 >= window_.size()) {
+        window_.drop_front(dead);
+        base_ += dead;
+    }
+}
+
+auto Lexer::next() -> Token {
+    skip_trivia();
+
+    // Bytes past the end read as the zero padding, so nothing here checks
+    // bounds until the NUL class does
+    const char* p        = src.data();
+    u32 start            = cursor;
+    const ByteInfo& info = LEX_TABLES.bytes[static_cast<u8>(p[cursor])];
+
+    switch (info.cls) {
+    case ByteClass::Operator: {
+        u8 next_byte   = static_cast<u8>(p[cursor + 1]);
+        u8 column      = LEX_TABLES.second[next_byte];
+        TokenKind pair = LEX_TABLES.pairs[info.row][column];
+        bool is_pair   = pair != TokenKind::Invalid;
+        cursor += 1 + is_pair;
+        return Token(is_pair ? pair : info.single, start, cursor);
+    }
+    case ByteClass::Ident:
+        return recognize_identifier();
+    case ByteClass::Digit:
+        return recognize_number();
+    case ByteClass::Str:
+        return recognize_string_literal();
+    case ByteClass::Char:
+        return recognize_char();
+    case ByteClass::Nul:
+        if (cursor >= src.size()) {
+            return Token(TokenKind::Eof, start, start);
         }
         break;
-
-    case '=':
-        if (peek("=>")) {
-            token = Token(TokenKind::FatArrow, cursor, cursor + 2);
-        } else if (peek("==")) {
-            token = Token(TokenKind::EqEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Eq, cursor, cursor + 1);
+    case ByteClass::Utf8: {
+        Utf8Char c = decode_utf8(p + cursor, src.size() - cursor);
+        if (c.length != 0 && is_xid_start(c.code_point)) {
+            return recognize_identifier();
         }
+        // A whole non-identifier character is one invalid token
+        cursor += std::max<u32>(c.length, 1);
+        return Token(TokenKind::Invalid, start, cursor);
+    }
+    case ByteClass::Invalid:
         break;
+    }
 
-    case '!':
-        if (peek("!=")) {
-            token = Token(TokenKind::BangEq, cursor, cursor + 2);
-        } else {
-            token = Token(TokenKind::Bang, cursor, cursor + 1);
+    // Consume the offending byte so callers looping on next() make progress
+    cursor++;
+    return Token(TokenKind::Invalid, start, cursor);
+}
+
+auto Lexer::tokenize_all(TokenStorage storage) -> TokenBuffer {
+    TokenBuffer tokens;
+    tokenize_into(tokens, storage);
+    return tokens;
+}
+
+auto Lexer::tokenize_into(TokenBuffer& tokens, TokenStorage storage) -> void {
+    tokens.reset(src, storage, owned);
+    tokens.reserve((src.size() - cursor) / BYTES_PER_TOKEN_ESTIMATE + 1);
+
+    while (true) {
+        Token token = next();
+        tokens.push(token);
+        if (token.kind == TokenKind::Eof) {
+            break;
         }
-        break;
+    }
+}
 
-    case '"':
-        return recognize_string_literal();
-    case '\'':
-        return recognize_char();
+namespace {
 
-    default:
-        if (std::isalpha(*ch) || *ch == '_') {
-            return recognize_identifier();
-        } else if (std::isdigit(*ch)) {
-            return recognize_number();
+// Tokens of one chunk, lexed as if a token started at the chunk's first
+// byte. Only tokens that start inside the chunk are kept; the last one may
+// run past its end.
+struct LexChunk {
+    u32 begin;
+    u32 end;
+    TokenBuffer tokens;
+    u32 resume; // cursor after the last kept token
+};
+
+} // namespace
+
+/**
+ * @brief Tokenizes the rest of the input on several threads.
+ *
+ * The input is cut into chunks that begin right after a newline, and each
+ * chunk is lexed speculatively on its own. A chunk that really starts inside
+ * a string or character literal, or inside any token running across the
+ * boundary, comes out wrong at its head, so the chunks are stitched in
+ * order: the serial lexer resumes where the previous chunk ended and relexes
+ * until it produces a token starting where a speculative token starts. From
+ * there on both streams agree, since a token depends only on its start
+ * offset, and the rest of the chunk is copied as is.
+ *
+ * @return The same tokens as tokenize_all, ending with Eof.
+ */
+auto Lexer::tokenize_parallel(const ParallelLexOptions& options)
+    -> TokenBuffer {
+    usize threads = worker_count(options.threads);
+    usize length  = src.size() - cursor;
+    usize chunk_size
+        = std::max(options.min_chunk_size, length / (threads * 4) + 1);
+    if (threads <= 1 || length <= chunk_size) {
+        return tokenize_all(options.storage);
+    }
+
+    std::vector<LexChunk> chunks;
+    for (usize begin = cursor; begin < src.size();) {
+        usize end = std::min(begin + chunk_size, src.size());
+        usize nl  = src.find('\n', end);
+        end       = nl == std::string_view::npos ? src.size() : nl + 1;
+        chunks.push_back({static_cast<u32>(begin),
+                          static_cast<u32>(end),
+                          TokenBuffer(src, options.storage, owned),
+                          0});
+        begin = end;
+    }
+
+    parallel_for(chunks.size(), threads, [&](usize i) {
+        LexChunk& chunk = chunks[i];
+        Lexer lexer(src, InPlace{});
+        lexer.cursor = chunk.begin;
+        chunk.tokens.reserve((chunk.end - chunk.begin)
+                                 / BYTES_PER_TOKEN_ESTIMATE
+                             + 1);
+        chunk.resume = chunk.begin;
+        while (true) {
+            Token token = lexer.next();
+            if (token.kind == TokenKind::Eof || token.start >= chunk.end) {
+                break;
+            }
+            chunk.tokens.push(token);
+            chunk.resume = token.end;
         }
+    });
 
-        token = Token(TokenKind::Invalid, cursor, cursor);
-        break;
+    usize total = 1;
+    for (const auto& chunk : chunks) {
+        total += chunk.tokens.size();
+    }
+    TokenBuffer tokens(src, options.storage, owned);
+    tokens.reserve(total);
+
+    // A token starting past a chunk is carried into the next one, so a
+    // comment spanning several chunks is only skipped once
+    std::optional<Token> carried;
+    for (const auto& chunk : chunks) {
+        while (true) {
+            Token token = carried ? *carried : next();
+            carried.reset();
+            if (token.kind == TokenKind::Eof || token.start >= chunk.end) {
+                carried = token;
+                break;
+            }
+
+            usize synced = chunk.tokens.lower_bound_start(token.start);
+            if (synced < chunk.tokens.size()
+                && chunk.tokens.start(synced) == token.start) {
+                tokens.append(chunk.tokens, synced);
+                cursor = chunk.resume;
+                break;
+            }
+            tokens.push(token);
+        }
     }
 
-    // Advance cursor by the token length
-    cursor = token.end;
-    return token;
+    while (true) {
+        Token token = carried ? *carried : next();
+        carried.reset();
+        tokens.push(token);
+        if (token.kind == TokenKind::Eof) {
+            break;
+        }
+    }
+    return tokens;
+}
+
+namespace {
+// Bytes past a token's end its lexing may read: an identifier decodes the
+// whole UTF-8 character after it to see whether it continues
+constexpr u32 RELEX_LOOKAHEAD = 4;
+} // namespace
+
+/**
+ * @brief Relexes the part of a token stream touched by an edit.
+ *
+ * A token is a function of the bytes from its start up to RELEX_LOOKAHEAD
+ * bytes past its end, so every token ending at least that far before the
+ * edit is kept.
+ * Lexing resumes after the last of them and stops at the first new token
+ * past the inserted text whose start, mapped back into the old source, is
+ * also the start of an old token: from there on the two streams agree up
+ * to the shift. Lexing costs the size of the edit and the tokens it
+ * disturbs; the tokens after them are not touched, since splice defers the
+ * shift. Moving the buffer's gap adds the tokens between this edit and the
+ * previous one, so a run of edits in one place never scans the file.
+ *
+ * @param tokens Tokens of the source before the edit, ending with Eof.
+ * @param replaced The replaced byte range, in old source offsets.
+ * @param inserted The text that replaced it.
+ * @return The updated stream and the range of tokens that changed.
+ */
+auto Lexer::relex(TokenBuffer tokens,
+                  Span replaced,
+                  std::string_view inserted) -> RelexResult {
+    i64 shift    = static_cast<i64>(inserted.size()) - replaced.len();
+    u32 edit_end = replaced.start + static_cast<u32>(inserted.size());
+
+    // Bytes before the edit are unchanged, so compact ends can be re-lexed
+    // against the new source
+    tokens.rebase(src, owned);
+
+    usize first = tokens.lower_bound_start(replaced.start);
+    while (first > 0
+           && tokens.end(first - 1) + RELEX_LOOKAHEAD > replaced.start) {
+        --first;
+    }
+
+    cursor = first > 0 ? tokens.end(first - 1) : 0;
+    TokenBuffer fresh(src, tokens.storage(), owned);
+    usize last = tokens.size();
+    while (true) {
+        Token token = next();
+        if (token.start >= edit_end) {
+            auto old_start = static_cast<u32>(token.start - shift);
+            usize synced   = tokens.lower_bound_start(old_start, first);
+            if (synced < tokens.size() && tokens.start(synced) == old_start) {
+                last = synced;
+                break;
+            }
+        }
+        fresh.push(token);
+        if (token.kind == TokenKind::Eof) {
+            break;
+        }
+    }
+
+    tokens.splice(first, last, fresh, shift);
+    return RelexResult{std::move(tokens), first, last, first + fresh.size()};
+}
+
+auto collect_trivia(const TokenBuffer& tokens) -> TriviaTable {
+    TriviaTable trivia;
+    Lexer lexer(tokens.src(), Lexer::InPlace{});
+    for (usize i = 0; i < tokens.size(); ++i) {
+        u32 start = tokens.start(i);
+        while (lexer.cursor < start) {
+            u32 from = lexer.cursor;
+            TriviaKind kind;
+            if (auto comment = lexer.skip_comment()) {
+                kind = *comment;
+            } else {
+                kind         = TriviaKind::Whitespace;
+                lexer.cursor = lexer.scan(lexer.kernels->padded_whitespace);
+            }
+            trivia.push(Trivia{kind, from, static_cast<u32>(lexer.cursor)});
+        }
+        trivia.end_token();
+        lexer.cursor = tokens.end(i);
+    }
+    return trivia;
+}
+
+namespace {
+/** @brief Two independently keyed 64-bit lanes fed the same words. */
+struct FingerprintState {
+    u64 a = 0x9E3779B97F4A7C15;
+    u64 b = 0xC2B2AE3D27D4EB4F;
+
+    auto absorb(u64 word) -> void {
+        a = std::rotl((a ^ word) * 0xFF51AFD7ED558CCD, 31);
+        b = std::rotl((b + word) * 0xC4CEB9FE1A85EC53, 27) ^ (b >> 29);
+    }
+};
+
+/** @brief Murmur3's 64-bit finalizer. */
+auto fmix64(u64 h) -> u64 {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCD;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53;
+    h ^= h >> 33;
+    return h;
+}
+} // namespace
+
+/**
+ * @brief Hashes each token as its kind and length followed by its text in
+ *        8-byte words, so no two token sequences feed the same words.
+ */
+auto fingerprint_tokens(const TokenBuffer& tokens) -> TokenFingerprint {
+    FingerprintState state;
+    const char* src = tokens.src().data();
+    for (usize i = 0; i < tokens.size(); ++i) {
+        u32 start = tokens.start(i);
+        u32 len   = tokens.end(i) - start;
+        state.absorb(static_cast<u64>(tokens.kind(i))
+                     | static_cast<u64>(len) << 8);
+
+        const char* text = src + start;
+        for (; len >= 8; len -= 8, text += 8) {
+            u64 word;
+            std::memcpy(&word, text, 8);
+            state.absorb(word);
+        }
+        if (len > 0) {
+            u64 word = 0;
+            std::memcpy(&word, text, len);
+            state.absorb(word);
+        }
+    }
+
+    u64 count = tokens.size();
+    return TokenFingerprint{
+        fmix64(state.a ^ std::rotl(state.b, 17) ^ count),
+        fmix64(state.b ^ (std::rotl(state.a, 41) + count)),
+    };
 }
 
 auto Lexer::peek(std::string_view str) -> bool {
@@ -254,11 +767,66 @@ auto Lexer::peek(std::string_view str) -> bool {
     return src.substr(cursor, str.size()) == str;
 }
 
+auto Lexer::skip_trivia() -> void {
+    do {
+        cursor = scan(kernels->padded_whitespace);
+    } while (skip_comment());
+}
+
+auto Lexer::skip_comment() -> std::optional<TriviaKind> {
+    const char* p = src.data();
+
+    if (p[cursor] == '-' && p[cursor + 1] == '-') {
+        usize newline = src.find('\n', cursor + 2);
+        cursor        = newline == std::string_view::npos ? src.size() : newline;
+        return TriviaKind::LineComment;
+    }
+
+    if (p[cursor] == '{' && p[cursor + 1] == '-') {
+        usize depth = 1;
+        cursor += 2;
+        while (depth > 0) {
+            char c = p[cursor];
+            if (c == '\0' && cursor >= src.size()) {
+                break; // Unterminated
+            }
+            if (c == '{' && p[cursor + 1] == '-') {
+                ++depth;
+                cursor += 2;
+            } else if (c == '-' && p[cursor + 1] == '}') {
+                --depth;
+                cursor += 2;
+            } else {
+                cursor++;
+            }
+        }
+        return TriviaKind::BlockComment;
+    }
+
+    return std::nullopt;
+}
+
+auto Lexer::scan(ScanKernels::PaddedScanner scanner) const -> usize {
+    const char* begin = src.data();
+    return scanner(begin + cursor) - begin;
+}
+
 auto Lexer::recognize_identifier() -> Token {
-    u32 start = cursor;
-    while (cursor < src.size()
-           && (std::isalnum(src[cursor]) || src[cursor] == '_')) {
-        cursor++;
+    const char* p = src.data();
+    u32 start     = cursor;
+
+    // ASCII runs go through the vector scanner; only a non-ASCII byte after
+    // a run costs a decode and a table lookup
+    while (true) {
+        cursor = scan(kernels->padded_ident_tail);
+        if (static_cast<u8>(p[cursor]) < 0x80) {
+            break;
+        }
+        Utf8Char c = decode_utf8(p + cursor, src.size() - cursor);
+        if (c.length == 0 || !is_xid_continue(c.code_point)) {
+            break;
+        }
+        cursor += c.length;
     }
     u32 end                = cursor;
 
@@ -271,81 +839,77 @@ auto Lexer::recognize_identifier() -> Token {
 }
 
 auto Lexer::recognize_string_literal() -> Token {
-    u32 start = cursor;
+    const char* p = src.data();
+    u32 start     = cursor;
     cursor++; // Skip opening quote
 
-    while (cursor < src.size() && src[cursor] != '"') {
-        if (src[cursor] == '\\' && cursor + 1 < src.size()) {
+    while (true) {
+        char c = p[cursor];
+        if (c == '"') {
+            cursor++; // Skip closing quote
+            break;
+        }
+        if (c == '\0' && cursor >= src.size()) {
+            break; // Unterminated
+        }
+        if (c == '\\' && cursor + 1 < src.size()) {
             cursor += 2; // Skip escape sequence
         } else {
             cursor++;
         }
     }
 
-    if (cursor < src.size()) {
-        cursor++; // Skip closing quote
-    }
-
     return Token(TokenKind::Str, start, cursor);
 }
 
 auto Lexer::recognize_number() -> Token {
-    u32 start = cursor;
+    // The NUL sentinel fails every digit test, so the loops below stop at
+    // the end of input without checking it
+    const char* p = src.data();
+    u32 start     = cursor;
 
     // Handle binary numbers (0b...)
-    if (src[cursor] == '0' && cursor + 1 < src.size()
-        && (src[cursor + 1] == 'b' || src[cursor + 1] == 'B')) {
+    if (p[cursor] == '0' && (p[cursor + 1] == 'b' || p[cursor + 1] == 'B')) {
         cursor += 2; // Skip "0b"
-        while (cursor < src.size()
-               && (src[cursor] == '0' || src[cursor] == '1')) {
+        while (p[cursor] == '0' || p[cursor] == '1') {
             cursor++;
         }
         return Token(TokenKind::IntBin, start, cursor);
     }
 
     // Handle octal numbers (0o...)
-    if (src[cursor] == '0' && cursor + 1 < src.size()
-        && (src[cursor + 1] == 'o' || src[cursor + 1] == 'O')) {
+    if (p[cursor] == '0' && (p[cursor + 1] == 'o' || p[cursor + 1] == 'O')) {
         cursor += 2; // Skip "0o"
-        while (cursor < src.size() && src[cursor] >= '0'
-               && src[cursor] <= '7') {
+        while (p[cursor] >= '0' && p[cursor] <= '7') {
             cursor++;
         }
         return Token(TokenKind::IntOct, start, cursor);
     }
 
     // Handle hexadecimal numbers (0x...)
-    if (src[cursor] == '0' && cursor + 1 < src.size()
-        && (src[cursor + 1] == 'x' || src[cursor + 1] == 'X')) {
+    if (p[cursor] == '0' && (p[cursor + 1] == 'x' || p[cursor + 1] == 'X')) {
         cursor += 2; // Skip "0x"
-        while (cursor < src.size() && std::isxdigit(src[cursor])) {
+        while (is_ascii_xdigit(p[cursor])) {
             cursor++;
         }
         return Token(TokenKind::IntHex, start, cursor);
     }
 
     // Handle decimal numbers
-    while (cursor < src.size() && std::isdigit(src[cursor])) {
-        cursor++;
-    }
+    cursor = scan(kernels->padded_digits);
 
-    // Check for decimal point
-    if (cursor < src.size() && src[cursor] == '.') {
+    // A decimal point needs a digit after it, so `1..5` stays a range
+    if (p[cursor] == '.' && is_ascii_digit(p[cursor + 1])) {
         cursor++; // Skip decimal point
-        while (cursor < src.size() && std::isdigit(src[cursor])) {
-            cursor++;
-        }
+        cursor = scan(kernels->padded_digits);
 
         // Check for scientific notation
-        if (cursor < src.size() && (src[cursor] == 'e' || src[cursor] == 'E')) {
+        if (p[cursor] == 'e' || p[cursor] == 'E') {
             cursor++; // Skip 'e' or 'E'
-            if (cursor < src.size()
-                && (src[cursor] == '+' || src[cursor] == '-')) {
+            if (p[cursor] == '+' || p[cursor] == '-') {
                 cursor++; // Skip sign
             }
-            while (cursor < src.size() && std::isdigit(src[cursor])) {
-                cursor++;
-            }
+            cursor = scan(kernels->padded_digits);
             return Token(TokenKind::RealSci, start, cursor);
         }
         return Token(TokenKind::Real, start, cursor);
@@ -355,46 +919,33 @@ auto Lexer::recognize_number() -> Token {
 }
 
 auto Lexer::recognize_char() -> Token {
-    u32 start = cursor;
+    const char* p = src.data();
+    u32 start     = cursor;
     cursor++; // Skip opening quote
 
-    if (cursor < src.size() && src[cursor] == '\\') {
+    if (p[cursor] == '\\') {
         cursor += 2; // Skip escape sequence
     } else {
         cursor++; // Skip character
     }
+    cursor = std::min(cursor, src.size()); // Quote or escape at the end
 
-    if (cursor < src.size() && src[cursor] == '\'') {
+    if (p[cursor] == '\'') {
         cursor++; // Skip closing quote
     }
 
     return Token(TokenKind::Char, start, cursor);
 }
 
-/**
- * @brief Checks if a given identifier is a language
- * keyword.
- *
- * This function takes a string view and determines if it
- * matches any of the reserved keywords in the language.
- *
- * @note The current implementation uses a linear series of
- * string comparisons, which has a time complexity
- * proportional to the number of keywords. For better
- * performance, this could be optimized by using a more
- * efficient lookup structure, such as a static
- * `std::unordered_map` or a perfect hash function, to
- * achieve constant-time average complexity.
- *
- * @param ident The identifier string to check.
- * @return An optional containing the corresponding
- * TokenKind if the identifier is a keyword, otherwise
- * std::nullopt.
- */
-auto Lexer::is_keyword(std::string_view ident) -> std::optional<TokenKind> {
-#define KEYWORD(keyword, kind)                                                 \
-    if (ident == #keyword)                                                     \
-        return TokenKind::kind;
+namespace {
+
+struct KeywordEntry {
+    std::string_view text;
+    TokenKind kind;
+};
+
+constexpr KeywordEntry KEYWORDS[] = {
+#define KEYWORD(keyword, kind) {#keyword, TokenKind::kind},
 
     KEYWORD(and, And)
     KEYWORD(as, As)
@@ -437,5 +988,115 @@ auto Lexer::is_keyword(std::string_view ident) -> std::optional<TokenKind> {
     KEYWORD(while, While)
 
 #undef KEYWORD
+};
+
+constexpr usize KEYWORD_MIN_LEN = [] {
+    usize len = SIZE_MAX;
+    for (const auto& keyword : KEYWORDS) {
+        len = std::min(len, keyword.text.size());
+    }
+    return len;
+}();
+
+constexpr usize KEYWORD_MAX_LEN = [] {
+    usize len = 0;
+    for (const auto& keyword : KEYWORDS) {
+        len = std::max(len, keyword.text.size());
+    }
+    return len;
+}();
+
+constexpr u32 KEYWORD_TABLE_BITS = 7;
+constexpr u32 KEYWORD_TABLE_SIZE = 1u << KEYWORD_TABLE_BITS;
+
+static_assert(KEYWORD_MIN_LEN >= 2, "keyword_key reads the first two bytes");
+static_assert(std::size(KEYWORDS) <= KEYWORD_TABLE_SIZE);
+
+// Packs the length, the first two bytes and the last byte of a word. A seed
+// is only accepted if these keys land in distinct slots, so they are also
+// distinct across the keyword set.
+constexpr auto keyword_key(std::string_view word) -> u32 {
+    return static_cast<u32>(static_cast<u8>(word[0]))
+           | static_cast<u32>(static_cast<u8>(word[1])) << 8
+           | static_cast<u32>(static_cast<u8>(word.back())) << 16
+           | static_cast<u32>(word.size()) << 24;
+}
+
+constexpr auto keyword_slot(u32 key, u32 seed) -> u32 {
+    u32 x = key ^ seed;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr auto is_perfect_seed(u32 seed) -> bool {
+    std::array<bool, KEYWORD_TABLE_SIZE> used{};
+    for (const auto& keyword : KEYWORDS) {
+        u32 slot = keyword_slot(keyword_key(keyword.text), seed);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr auto find_keyword_seed() -> u32 {
+    for (u32 seed = 0; seed < 100000; ++seed) {
+        if (is_perfect_seed(seed)) {
+            return seed;
+        }
+    }
+    return UINT32_MAX;
+}
+
+constexpr u32 KEYWORD_SEED = find_keyword_seed();
+static_assert(KEYWORD_SEED != UINT32_MAX,
+              "no perfect hash seed found for the keyword set");
+
+// Empty slots hold an empty string, which never equals a candidate because
+// candidates are at least KEYWORD_MIN_LEN bytes long.
+constexpr auto build_keyword_table() {
+    std::array<KeywordEntry, KEYWORD_TABLE_SIZE> table{};
+    for (auto& entry : table) {
+        entry = {"", TokenKind::Id};
+    }
+    for (const auto& keyword : KEYWORDS) {
+        table[keyword_slot(keyword_key(keyword.text), KEYWORD_SEED)] = keyword;
+    }
+    return table;
+}
+
+constexpr auto KEYWORD_TABLE = build_keyword_table();
+
+} // namespace
+
+/**
+ * @brief Checks if a given identifier is a language
+ * keyword.
+ *
+ * Lookup goes through a perfect hash over the keyword set
+ * that is built at compile time: the length and the first,
+ * second and last bytes select exactly one table slot, and
+ * a single string comparison against that slot decides the
+ * result.
+ *
+ * @param ident The identifier string to check.
+ * @return An optional containing the corresponding
+ * TokenKind if the identifier is a keyword, otherwise
+ * std::nullopt.
+ */
+auto Lexer::is_keyword(std::string_view ident) -> std::optional<TokenKind> {
+    if (ident.size() < KEYWORD_MIN_LEN || ident.size() > KEYWORD_MAX_LEN) {
+        return std::nullopt;
+    }
+
+    const auto& entry
+        = KEYWORD_TABLE[keyword_slot(keyword_key(ident), KEYWORD_SEED)];
+    if (entry.text == ident) {
+        return entry.kind;
+    }
     return std::nullopt;
 }
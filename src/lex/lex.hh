@@ -2,10 +2,17 @@
 #define LEX_HH
 
 #include "common.hh"
+#include "lex/scan.hh"
+#include "source_map/source_map.hh"
 #include <format>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
+#include <utility>
+#include <vector>
 
-enum class TokenKind {
+enum class TokenKind : u8 {
     // operators
     Plus,       // +
     PlusEq,     // +=
@@ -149,15 +156,349 @@ struct std::formatter<Token> {
     }
 };
 
+/// How a TokenBuffer stores token extents.
+enum class TokenStorage : u8 {
+    Full,    // kind + start + end, 9 bytes per token
+    Compact, // kind + start, 5 bytes per token; ends are re-lexed on demand
+};
+
+/// Structure-of-arrays token storage.
+///
+/// Kinds, start offsets and end offsets live in three dense arrays, so
+/// lookahead over kinds touches one byte per token and never pulls offsets
+/// into cache.
+///
+/// In compact storage the end array is dropped. Operators, keywords and Eof
+/// have a fixed length, and any other token is re-lexed from its start in
+/// the source the buffer was built from, so `end()` stays transparent to
+/// callers.
+///
+/// Edits leave a gap in the arrays where the last one happened, and the
+/// tokens after it keep their old offsets plus one pending shift added on
+/// read (see splice). The next edit only moves the tokens between the two
+/// edit points. Accessors by index see through the gap; the span views
+/// close it first.
+class TokenBuffer {
+  private:
+    std::vector<TokenKind> kinds_;
+    std::vector<u32> starts_;
+    std::vector<u32> ends_;
+    std::string_view src_;
+    std::shared_ptr<const SourceText> owner_;
+    TokenStorage storage_ = TokenStorage::Full;
+    // Tokens from index `gap_` on are stored `gap_len_` slots further in,
+    // with offsets `shift_` bytes short of their real ones
+    usize gap_     = 0;
+    usize gap_len_ = 0;
+    i64 shift_     = 0;
+
+    auto compact_end(usize index) const -> u32;
+
+    auto slot(usize index) const -> usize {
+        return index < gap_ ? index : index + gap_len_;
+    }
+
+    auto offset(u32 stored, usize index) const -> u32 {
+        return index < gap_ ? stored : static_cast<u32>(stored + shift_);
+    }
+
+    // Moves the gap so it starts before token `index`
+    auto move_gap(usize index) -> void;
+
+    // Appends tokens [first, last) to the dense arrays of `into`
+    auto copy_range(TokenBuffer& into, usize first, usize last) const -> void;
+
+  public:
+    TokenBuffer() = default;
+
+    // `src` must be padded like a SourceText. `owner` keeps it alive when
+    // the lexer made the padded copy itself.
+    TokenBuffer(std::string_view src,
+                TokenStorage storage,
+                std::shared_ptr<const SourceText> owner = nullptr)
+        : src_(src), owner_(std::move(owner)), storage_(storage) {
+    }
+
+    explicit TokenBuffer(std::span<const Token> tokens) {
+        reserve(tokens.size());
+        for (const auto& token : tokens) {
+            push(token);
+        }
+    }
+
+    /// Empties the buffer and points it at a new source, keeping the
+    /// capacity of its arrays for the next file.
+    auto reset(std::string_view src,
+               TokenStorage storage,
+               std::shared_ptr<const SourceText> owner = nullptr) -> void {
+        kinds_.clear();
+        starts_.clear();
+        ends_.clear();
+        src_     = src;
+        owner_   = std::move(owner);
+        storage_ = storage;
+        gap_     = 0;
+        gap_len_ = 0;
+        shift_   = 0;
+    }
+
+    auto reserve(usize capacity) -> void {
+        kinds_.reserve(capacity);
+        starts_.reserve(capacity);
+        if (storage_ == TokenStorage::Full) {
+            ends_.reserve(capacity);
+        }
+    }
+
+    auto push(Token token) -> void {
+        close_gap();
+        kinds_.push_back(token.kind);
+        starts_.push_back(token.start);
+        if (storage_ == TokenStorage::Full) {
+            ends_.push_back(token.end);
+        }
+    }
+
+    /// Appends tokens [first, other.size()) of a buffer with the same
+    /// storage mode.
+    auto append(const TokenBuffer& other, usize first) -> void;
+
+    /// Replaces tokens [first, last) with the tokens of `replacement` and
+    /// moves every token after them by `shift` bytes.
+    ///
+    /// The tokens after the edit are neither copied nor rewritten: the gap
+    /// moves to the edit and the shift is added to the pending one. The
+    /// cost is the size of the replacement plus the distance from the
+    /// previous edit. When the replacement does not fit in the gap, the gap
+    /// grows by a fraction of the buffer, so growing stays amortized.
+    auto splice(usize first,
+                usize last,
+                const TokenBuffer& replacement,
+                i64 shift) -> void;
+
+    /// Moves the tokens after the gap back and applies the pending shift,
+    /// so the arrays are dense again. Costs one pass over those tokens.
+    auto close_gap() -> void;
+
+    /// Removes the first `count` tokens.
+    auto drop_front(usize count) -> void;
+
+    /// Copies tokens [first, last) into a buffer over the same source,
+    /// closed by an empty Eof token where token `last` starts, so the
+    /// range can be parsed on its own.
+    auto slice(usize first, usize last) const -> TokenBuffer;
+
+    /// Points the buffer at a new copy of its source, e.g. after an edit.
+    auto rebase(std::string_view src,
+                std::shared_ptr<const SourceText> owner = nullptr) -> void {
+        src_   = src;
+        owner_ = std::move(owner);
+    }
+
+    auto size() const -> usize {
+        return kinds_.size() - gap_len_;
+    }
+
+    auto empty() const -> bool {
+        return size() == 0;
+    }
+
+    auto capacity() const -> usize {
+        return kinds_.capacity();
+    }
+
+    auto storage() const -> TokenStorage {
+        return storage_;
+    }
+
+    auto src() const -> std::string_view {
+        return src_;
+    }
+
+    /// Bytes held by the token arrays, including spare capacity.
+    auto memory_usage() const -> usize {
+        return kinds_.capacity() * sizeof(TokenKind)
+               + starts_.capacity() * sizeof(u32)
+               + ends_.capacity() * sizeof(u32);
+    }
+
+    auto kind(usize index) const -> TokenKind {
+        return kinds_[slot(index)];
+    }
+
+    auto start(usize index) const -> u32 {
+        return offset(starts_[slot(index)], index);
+    }
+
+    auto end(usize index) const -> u32 {
+        if (storage_ == TokenStorage::Full) {
+            return offset(ends_[slot(index)], index);
+        }
+        return compact_end(index);
+    }
+
+    auto get(usize index) const -> Token {
+        return Token(kind(index), start(index), end(index));
+    }
+
+    /// Index of the first token at or after `from` that starts at or after
+    /// `pos`, or size() if there is none.
+    auto lower_bound_start(u32 pos, usize from = 0) const -> usize;
+
+    // The views close the gap first
+    auto kinds() -> std::span<const TokenKind> {
+        close_gap();
+        return kinds_;
+    }
+
+    auto starts() -> std::span<const u32> {
+        close_gap();
+        return starts_;
+    }
+};
+
+/// Kinds of source text that separate tokens.
+enum class TriviaKind : u8 {
+    Whitespace,
+    LineComment,  // -- up to the end of the line
+    BlockComment, // {- ... -}, nesting
+};
+
+struct Trivia {
+    TriviaKind kind;
+    u32 start;
+    u32 end;
+};
+
+/// Whitespace and comments of a token stream, kept beside it.
+///
+/// Every token owns the trivia between the end of the previous token and
+/// its own start, and trailing trivia belongs to Eof. Writing out each
+/// token's leading trivia followed by the token text reproduces the source
+/// exactly, while the token stream the parser sees stays free of trivia.
+class TriviaTable {
+  private:
+    std::vector<Trivia> pieces_;
+    std::vector<u32> first_; // first piece of each token, plus an end marker
+
+  public:
+    TriviaTable() : first_{0} {
+    }
+
+    auto push(Trivia trivia) -> void {
+        pieces_.push_back(trivia);
+    }
+
+    // Closes the leading trivia of the next token
+    auto end_token() -> void {
+        first_.push_back(static_cast<u32>(pieces_.size()));
+    }
+
+    auto token_count() const -> usize {
+        return first_.size() - 1;
+    }
+
+    auto leading(usize token) const -> std::span<const Trivia> {
+        return std::span(pieces_).subspan(first_[token],
+                                          first_[token + 1] - first_[token]);
+    }
+
+    auto pieces() const -> std::span<const Trivia> {
+        return pieces_;
+    }
+};
+
+/// Splits the gaps between the tokens of `tokens` into trivia.
+auto collect_trivia(const TokenBuffer& tokens) -> TriviaTable;
+
+/// 128-bit hash of a token sequence: every token's kind and text, in
+/// order. Trivia is not part of it, so two versions of a file that differ
+/// only in whitespace and comments have the same fingerprint.
+struct TokenFingerprint {
+    u64 lo = 0;
+    u64 hi = 0;
+
+    auto operator==(const TokenFingerprint&) const -> bool = default;
+};
+
+/// Fingerprints `tokens` over the text they point into.
+auto fingerprint_tokens(const TokenBuffer& tokens) -> TokenFingerprint;
+
+/// Tuning for Lexer::tokenize_parallel.
+struct ParallelLexOptions {
+    usize threads        = 0; // 0 means one per hardware thread
+    usize min_chunk_size = 256 * 1024;
+    TokenStorage storage = TokenStorage::Full;
+};
+
+/// Outcome of Lexer::relex.
+///
+/// Tokens [first, old_last) of the old stream were replaced by tokens
+/// [first, new_last) of `tokens`; everything else was kept, with offsets
+/// after the edit shifted.
+struct RelexResult {
+    TokenBuffer tokens;
+    usize first;
+    usize old_last;
+    usize new_last;
+};
+
+/// Length of every token of `kind`, or std::nullopt if it depends on the
+/// source text (identifiers, literals, invalid bytes).
+auto fixed_token_length(TokenKind kind) -> std::optional<u32>;
+
 struct Lexer {
+    // Source bytes per token assumed when presizing a TokenBuffer. Slightly
+    // below what typical code produces, so one reservation is usually enough.
+    static constexpr usize BYTES_PER_TOKEN_ESTIMATE = 4;
+
+    // Lexing relies on SourceText::PADDING zero bytes after `src`. Input
+    // without them is copied into `owned` first.
+    std::shared_ptr<const SourceText> owned;
     std::string_view src;
     usize cursor;
+    const ScanKernels* kernels;
+
+    struct InPlace {};
 
-    Lexer(std::string_view src) : src(src), cursor(0) {
+    // Lexes `src` without copying; the caller guarantees the padding, as a
+    // TokenBuffer does for its source.
+    Lexer(std::string_view src, InPlace)
+        : src(src), cursor(0), kernels(&active_scan_kernels()) {
+    }
+
+    Lexer(const SourceText& text) : Lexer(text.view(), InPlace{}) {
+    }
+
+    // Slow path for plain input: lexes a padded copy of `src`.
+    Lexer(std::string_view src)
+        : owned(std::make_shared<const SourceText>(src)), src(owned->view()),
+          cursor(0), kernels(&active_scan_kernels()) {
     }
 
     auto next() -> Token;
 
+    // Lexes from the cursor to the end of input. The result always ends with
+    // an Eof token.
+    auto tokenize_all(TokenStorage storage = TokenStorage::Full)
+        -> TokenBuffer;
+
+    // Same result as tokenize_all, written into `tokens` in place of what
+    // it held so its arrays are reused.
+    auto tokenize_into(TokenBuffer& tokens,
+                       TokenStorage storage = TokenStorage::Full) -> void;
+
+    // Same result as tokenize_all, but the input is split into chunks at
+    // newlines that are lexed concurrently and then stitched back together.
+    auto tokenize_parallel(const ParallelLexOptions& options = {})
+        -> TokenBuffer;
+
+    // Updates `tokens`, lexed from the source before an edit, to match `src`,
+    // which is that source with `replaced` overwritten by `inserted`. Only
+    // the tokens around the edit are relexed.
+    auto relex(TokenBuffer tokens, Span replaced, std::string_view inserted)
+        -> RelexResult;
+
     auto current_char() -> std::optional<char> {
         if (cursor >= src.size()) {
             return std::nullopt;
@@ -167,10 +508,112 @@ struct Lexer {
 
     auto peek(std::string_view str) -> bool;
 
+    // Moves the cursor past whitespace and comments.
+    auto skip_trivia() -> void;
+
+    // Moves the cursor past a comment starting at it, if there is one.
+    auto skip_comment() -> std::optional<TriviaKind>;
+
+    // Runs `scanner` from the cursor and returns the offset where it stopped.
+    auto scan(ScanKernels::PaddedScanner scanner) const -> usize;
+
     auto recognize_identifier() -> Token;
     auto recognize_string_literal() -> Token;
     auto recognize_number() -> Token;
     auto recognize_char() -> Token;
     auto is_keyword(std::string_view ident) -> std::optional<TokenKind>;
 };
+
+/// Tokens handed to the parser, either all at once or pulled on demand.
+///
+/// A stream built from a TokenBuffer holds every token. A stream built from
+/// a Lexer lexes tokens the first time they are looked at and keeps only a
+/// window of them: `release(index)` gives up every token before `index`, so
+/// memory follows how far back the parser can still go rather than the
+/// size of the file. Token indices are absolute either way.
+///
+/// Accessors are const: filling the window is a cache, not a change to the
+/// stream's contents.
+class TokenStream {
+  private:
+    // Tokens lexed per refill
+    static constexpr usize FILL_BATCH = 256;
+    // Released tokens are only dropped once there are this many, so the
+    // window moves in large, amortized steps
+    static constexpr usize DROP_THRESHOLD = 4096;
+
+    mutable TokenBuffer window_;
+    mutable std::optional<Lexer> lexer_; // engaged until Eof is lexed
+    usize base_     = 0; // absolute index of window_[0]
+    usize released_ = 0; // tokens before this index may be dropped
+
+    auto fill(usize index) const -> void;
+
+  public:
+    TokenStream() = default;
+
+    explicit TokenStream(TokenBuffer tokens) : window_(std::move(tokens)) {
+        window_.close_gap();
+    }
+
+    explicit TokenStream(Lexer lexer,
+                         TokenStorage storage = TokenStorage::Full)
+        : window_(lexer.src, storage, lexer.owned),
+          lexer_(std::move(lexer)) {
+    }
+
+    /// Whether token `index` is available, lexing up to it if needed.
+    /// False past Eof and for tokens already dropped.
+    auto has(usize index) const -> bool {
+        if (index < base_) {
+            return false;
+        }
+        fill(index);
+        return index - base_ < window_.size();
+    }
+
+    // The accessors below require has(index)
+    auto kind(usize index) const -> TokenKind {
+        return window_.kind(index - base_);
+    }
+
+    auto start(usize index) const -> u32 {
+        return window_.start(index - base_);
+    }
+
+    auto end(usize index) const -> u32 {
+        return window_.end(index - base_);
+    }
+
+    auto get(usize index) const -> Token {
+        return window_.get(index - base_);
+    }
+
+    /// Kinds of tokens [index, index + count); all must be available.
+    auto kinds(usize index, usize count) const
+        -> std::span<const TokenKind> {
+        return window_.kinds().subspan(index - base_, count);
+    }
+
+    /// Lets go of every token before `index`.
+    auto release(usize index) -> void;
+
+    /// Hands back the token arrays, leaving the stream empty. Meant for
+    /// reusing their capacity; tokens already dropped are gone.
+    auto take_buffer() -> TokenBuffer {
+        lexer_.reset();
+        base_     = 0;
+        released_ = 0;
+        return std::exchange(window_, TokenBuffer());
+    }
+
+    auto is_streaming() const -> bool {
+        return lexer_.has_value();
+    }
+
+    /// Tokens currently held in memory.
+    auto window_size() const -> usize {
+        return window_.size();
+    }
+};
 #endif
\ No newline at end of file
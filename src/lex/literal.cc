@@ -0,0 +1,233 @@
+#include "lex/literal.hh"
+#include <charconv>
+
+namespace {
+
+auto parse_int(std::string_view digits, int base) -> LiteralPool::Value {
+    u64 value      = 0;
+    const char* b  = digits.data();
+    const char* e  = b + digits.size();
+    auto [ptr, ec] = std::from_chars(b, e, value, base);
+    if (digits.empty() || ec != std::errc() || ptr != e) {
+        return std::monostate{};
+    }
+    return value;
+}
+
+auto parse_real(std::string_view text) -> LiteralPool::Value {
+    f64 value      = 0;
+    const char* b  = text.data();
+    const char* e  = b + text.size();
+    auto [ptr, ec] = std::from_chars(b, e, value);
+    if (ec != std::errc() || ptr != e) {
+        return std::monostate{};
+    }
+    return value;
+}
+
+auto append_utf8(String& out, u32 cp) -> void {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Decodes the escape sequence starting after the backslash at `text[i]`,
+// advancing `i` past it.
+auto decode_escape(std::string_view text, usize& i) -> std::optional<u32> {
+    if (i >= text.size()) {
+        return std::nullopt;
+    }
+
+    switch (text[i++]) {
+    case 'n':
+        return '\n';
+    case 't':
+        return '\t';
+    case 'r':
+        return '\r';
+    case '0':
+        return '\0';
+    case '\\':
+        return '\\';
+    case '"':
+        return '"';
+    case '\'':
+        return '\'';
+    case 'x': {
+        // \x{1F600}
+        usize close = text.find('}', i);
+        if (i >= text.size() || text[i] != '{'
+            || close == std::string_view::npos) {
+            return std::nullopt;
+        }
+        u32 cp         = 0;
+        const char* b  = text.data() + i + 1;
+        const char* e  = text.data() + close;
+        auto [ptr, ec] = std::from_chars(b, e, cp, 16);
+        if (b == e || ec != std::errc() || ptr != e || cp > 0x10FFFF
+            || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return std::nullopt;
+        }
+        i = close + 1;
+        return cp;
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+// Decodes `"..."`; the text is borrowed from the source unless it contains
+// escapes.
+auto decode_str(LiteralPool& pool, std::string_view text, u32 start)
+    -> LiteralPool::Value {
+    if (text.size() < 2 || text.back() != '"') {
+        return std::monostate{};
+    }
+
+    std::string_view body = text.substr(1, text.size() - 2);
+    usize escape          = body.find('\\');
+    if (escape == std::string_view::npos) {
+        return LiteralPool::Text{start + 1,
+                                 static_cast<u32>(body.size()),
+                                 false};
+    }
+
+    String decoded(body.substr(0, escape));
+    for (usize i = escape; i < body.size();) {
+        if (body[i] != '\\') {
+            decoded += body[i++];
+            continue;
+        }
+        ++i;
+        auto cp = decode_escape(body, i);
+        if (!cp) {
+            return std::monostate{};
+        }
+        append_utf8(decoded, *cp);
+    }
+    return pool.store(decoded);
+}
+
+// Decodes `'c'` or `'\n'` to a code point.
+auto decode_char(std::string_view text) -> LiteralPool::Value {
+    if (text.size() < 3 || text.back() != '\'') {
+        return std::monostate{};
+    }
+
+    std::string_view body = text.substr(1, text.size() - 2);
+    if (body[0] == '\\') {
+        usize i = 1;
+        auto cp = decode_escape(body, i);
+        if (!cp || i != body.size()) {
+            return std::monostate{};
+        }
+        return *cp;
+    }
+    if (body.size() != 1 || static_cast<u8>(body[0]) >= 0x80) {
+        return std::monostate{};
+    }
+    return static_cast<u32>(body[0]);
+}
+
+} // namespace
+
+auto LiteralPool::int_value(u32 index) const -> std::optional<u64> {
+    if (const u64* value = std::get_if<u64>(&values_[index])) {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+auto LiteralPool::real_value(u32 index) const -> std::optional<f64> {
+    if (const f64* value = std::get_if<f64>(&values_[index])) {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+auto LiteralPool::char_value(u32 index) const -> std::optional<u32> {
+    if (const u32* value = std::get_if<u32>(&values_[index])) {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+auto LiteralPool::str_value(u32 index) const
+    -> std::optional<std::string_view> {
+    const Text* text = std::get_if<Text>(&values_[index]);
+    if (text == nullptr) {
+        return std::nullopt;
+    }
+    std::string_view bytes = text->decoded ? std::string_view(arena_) : src_;
+    return bytes.substr(text->offset, text->size);
+}
+
+/**
+ * @brief Decodes the literal tokens of a buffer into a pool.
+ *
+ * Runs once right after lexing, so later passes read values from the pool
+ * instead of re-scanning token text. Integers and reals go through
+ * std::from_chars, which parses floats exactly with a fast path for the
+ * common cases.
+ */
+auto decode_literals(const TokenBuffer& tokens) -> LiteralPool {
+    LiteralPool pool;
+    decode_literals(tokens, pool);
+    return pool;
+}
+
+auto decode_literals(const TokenBuffer& tokens, LiteralPool& pool) -> void {
+    std::string_view src = tokens.src();
+    pool.reset(src, tokens.size());
+
+    for (usize i = 0; i < tokens.size(); ++i) {
+        TokenKind kind = tokens.kind(i);
+        if (kind < TokenKind::Str || kind > TokenKind::Char) {
+            continue;
+        }
+
+        u32 start             = tokens.start(i);
+        std::string_view text = src.substr(start, tokens.end(i) - start);
+
+        LiteralPool::Value value;
+        switch (kind) {
+        case TokenKind::Int:
+            value = parse_int(text, 10);
+            break;
+        case TokenKind::IntBin:
+            value = parse_int(text.substr(2), 2);
+            break;
+        case TokenKind::IntOct:
+            value = parse_int(text.substr(2), 8);
+            break;
+        case TokenKind::IntHex:
+            value = parse_int(text.substr(2), 16);
+            break;
+        case TokenKind::Real:
+        case TokenKind::RealSci:
+            value = parse_real(text);
+            break;
+        case TokenKind::Str:
+            value = decode_str(pool, text, start);
+            break;
+        case TokenKind::Char:
+            value = decode_char(text);
+            break;
+        default:
+            break;
+        }
+        pool.push(static_cast<u32>(i), value);
+    }
+}
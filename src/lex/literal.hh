@@ -0,0 +1,111 @@
+#ifndef LITERAL_HH
+#define LITERAL_HH
+
+#include "common.hh"
+#include "lex/lex.hh"
+#include <optional>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/// Decoded values of the literal tokens in a TokenBuffer.
+///
+/// Integers are decoded to u64, reals to f64, character literals to a code
+/// point and strings to their text with escapes resolved. A string without
+/// escapes is kept as a view into the source; only strings that need
+/// unescaping are copied, into one shared arena. A literal that does not
+/// decode (out of range, bad escape, missing digits) has no value.
+class LiteralPool {
+  public:
+    // Byte range of a decoded string, in the source or in the arena
+    struct Text {
+        u32 offset;
+        u32 size;
+        bool decoded;
+    };
+
+    using Value = std::variant<std::monostate, u64, f64, u32, Text>;
+
+  private:
+    std::string_view src_;
+    std::vector<u32> tokens_; // token index of each literal, ascending
+    std::vector<u32> slots_;  // pool index by token index, or NO_LITERAL
+    std::vector<Value> values_;
+    String arena_;
+
+  public:
+    static constexpr u32 NO_LITERAL = ~u32(0);
+
+    LiteralPool() = default;
+
+    explicit LiteralPool(std::string_view src) : src_(src) {
+    }
+
+    /// Empties the pool for a buffer of `tokens` tokens lexed from `src`,
+    /// keeping the capacity of its arrays.
+    auto reset(std::string_view src, usize tokens) -> void {
+        src_ = src;
+        tokens_.clear();
+        values_.clear();
+        arena_.clear();
+        slots_.assign(tokens, NO_LITERAL);
+    }
+
+    auto push(u32 token, Value value) -> void {
+        if (token >= slots_.size()) {
+            slots_.resize(token + 1, NO_LITERAL);
+        }
+        slots_[token] = static_cast<u32>(values_.size());
+        tokens_.push_back(token);
+        values_.push_back(value);
+    }
+
+    // Appends unescaped string bytes and returns their range
+    auto store(std::string_view text) -> Text {
+        Text stored{static_cast<u32>(arena_.size()),
+                    static_cast<u32>(text.size()),
+                    true};
+        arena_ += text;
+        return stored;
+    }
+
+    auto size() const -> usize {
+        return values_.size();
+    }
+
+    /// Pool index of the literal at token `token`, if it is one.
+    auto find(usize token) const -> std::optional<u32> {
+        if (token >= slots_.size() || slots_[token] == NO_LITERAL) {
+            return std::nullopt;
+        }
+        return slots_[token];
+    }
+
+    auto token(u32 index) const -> u32 {
+        return tokens_[index];
+    }
+
+    auto is_valid(u32 index) const -> bool {
+        return !std::holds_alternative<std::monostate>(values_[index]);
+    }
+
+    auto int_value(u32 index) const -> std::optional<u64>;
+    auto real_value(u32 index) const -> std::optional<f64>;
+    auto char_value(u32 index) const -> std::optional<u32>;
+    auto str_value(u32 index) const -> std::optional<std::string_view>;
+
+    /// Whether a string literal is a zero-copy view into the source.
+    auto is_borrowed(u32 index) const -> bool {
+        const Text* text = std::get_if<Text>(&values_[index]);
+        return text != nullptr && !text->decoded;
+    }
+};
+
+/// Decodes every literal token of `tokens` once, against the source the
+/// buffer was lexed from.
+auto decode_literals(const TokenBuffer& tokens) -> LiteralPool;
+
+/// Same, refilling `pool` in place so repeated decoding reuses its arrays.
+auto decode_literals(const TokenBuffer& tokens, LiteralPool& pool) -> void;
+
+#endif // LITERAL_HH
@@ -0,0 +1,226 @@
+#include "lex/scan.hh"
+#include <bit>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BELEG_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct WhitespaceClass {
+    static constexpr auto scalar(char c) -> bool {
+        return is_ascii_space(c);
+    }
+
+#ifdef BELEG_SCAN_X86
+    static auto sse2(__m128i v) -> __m128i {
+        __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        __m128i ctrl  = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                     _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+        return _mm_or_si128(space, ctrl);
+    }
+
+    [[gnu::target("avx2")]] static auto avx2(__m256i v) -> __m256i {
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        __m256i ctrl
+            = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                               _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+        return _mm256_or_si256(space, ctrl);
+    }
+#endif
+};
+
+struct DigitClass {
+    static constexpr auto scalar(char c) -> bool {
+        return is_ascii_digit(c);
+    }
+
+#ifdef BELEG_SCAN_X86
+    static auto sse2(__m128i v) -> __m128i {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                             _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    }
+
+    [[gnu::target("avx2")]] static auto avx2(__m256i v) -> __m256i {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    }
+#endif
+};
+
+struct IdentTailClass {
+    static constexpr auto scalar(char c) -> bool {
+        return is_ident_continue(c);
+    }
+
+    // Folding 0x20 into the byte maps 'A'..'Z' onto 'a'..'z' and moves every
+    // other ASCII byte outside that range, so one range check covers both
+    // cases. Bytes >= 0x80 are negative as signed chars and fail every range.
+#ifdef BELEG_SCAN_X86
+    static auto sse2(__m128i v) -> __m128i {
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(alpha, under), DigitClass::sse2(v));
+    }
+
+    [[gnu::target("avx2")]] static auto avx2(__m256i v) -> __m256i {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i alpha
+            = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                               _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        return _mm256_or_si256(_mm256_or_si256(alpha, under),
+                               DigitClass::avx2(v));
+    }
+#endif
+};
+
+template <typename Class>
+auto scalar_run(const char* p, const char* end) -> const char* {
+    while (p < end && Class::scalar(*p)) {
+        p++;
+    }
+    return p;
+}
+
+template <typename Class>
+auto scalar_padded_run(const char* p) -> const char* {
+    while (Class::scalar(*p)) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef BELEG_SCAN_X86
+template <typename Class>
+auto sse2_run(const char* p, const char* end) -> const char* {
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        u32 miss      = ~static_cast<u32>(_mm_movemask_epi8(Class::sse2(block)))
+                   & 0xFFFFu;
+        if (miss != 0) {
+            return p + std::countr_zero(miss);
+        }
+        p += 16;
+    }
+    return scalar_run<Class>(p, end);
+}
+
+template <typename Class>
+[[gnu::target("avx2")]] auto avx2_run(const char* p, const char* end)
+    -> const char* {
+    while (end - p >= 32) {
+        __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        u32 miss = ~static_cast<u32>(_mm256_movemask_epi8(Class::avx2(block)));
+        if (miss != 0) {
+            return p + std::countr_zero(miss);
+        }
+        p += 32;
+    }
+    return sse2_run<Class>(p, end);
+}
+
+template <typename Class>
+auto sse2_padded_run(const char* p) -> const char* {
+    while (true) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        u32 miss      = ~static_cast<u32>(_mm_movemask_epi8(Class::sse2(block)))
+                   & 0xFFFFu;
+        if (miss != 0) {
+            return p + std::countr_zero(miss);
+        }
+        p += 16;
+    }
+}
+
+template <typename Class>
+[[gnu::target("avx2")]] auto avx2_padded_run(const char* p) -> const char* {
+    while (true) {
+        __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        u32 miss = ~static_cast<u32>(_mm256_movemask_epi8(Class::avx2(block)));
+        if (miss != 0) {
+            return p + std::countr_zero(miss);
+        }
+        p += 32;
+    }
+}
+#endif
+
+constexpr ScanKernels scalar_kernels{
+    "scalar",
+    scalar_run<WhitespaceClass>,
+    scalar_run<IdentTailClass>,
+    scalar_run<DigitClass>,
+    scalar_padded_run<WhitespaceClass>,
+    scalar_padded_run<IdentTailClass>,
+    scalar_padded_run<DigitClass>,
+};
+
+#ifdef BELEG_SCAN_X86
+constexpr ScanKernels sse2_kernels{
+    "sse2",
+    sse2_run<WhitespaceClass>,
+    sse2_run<IdentTailClass>,
+    sse2_run<DigitClass>,
+    sse2_padded_run<WhitespaceClass>,
+    sse2_padded_run<IdentTailClass>,
+    sse2_padded_run<DigitClass>,
+};
+
+constexpr ScanKernels avx2_kernels{
+    "avx2",
+    avx2_run<WhitespaceClass>,
+    avx2_run<IdentTailClass>,
+    avx2_run<DigitClass>,
+    avx2_padded_run<WhitespaceClass>,
+    avx2_padded_run<IdentTailClass>,
+    avx2_padded_run<DigitClass>,
+};
+
+auto cpu_has_sse2() -> bool {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+auto cpu_has_avx2() -> bool {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+auto detect_scan_kernels() -> const ScanKernels& {
+#ifdef BELEG_SCAN_X86
+    if (cpu_has_avx2()) {
+        return avx2_kernels;
+    }
+    if (cpu_has_sse2()) {
+        return sse2_kernels;
+    }
+#endif
+    return scalar_kernels;
+}
+
+} // namespace
+
+auto active_scan_kernels() -> const ScanKernels& {
+    static const ScanKernels& kernels = detect_scan_kernels();
+    return kernels;
+}
+
+auto supported_scan_kernels() -> std::vector<ScanKernels> {
+    std::vector<ScanKernels> kernels = {scalar_kernels};
+#ifdef BELEG_SCAN_X86
+    if (cpu_has_sse2()) {
+        kernels.push_back(sse2_kernels);
+    }
+    if (cpu_has_avx2()) {
+        kernels.push_back(avx2_kernels);
+    }
+#endif
+    return kernels;
+}
@@ -0,0 +1,67 @@
+#ifndef SCAN_HH
+#define SCAN_HH
+
+#include "common.hh"
+#include <vector>
+
+/// ASCII character classes used by the lexer.
+///
+/// These replace the `<cctype>` predicates, which are locale-aware libc
+/// calls and undefined for negative `char` values. They classify exactly
+/// like the "C" locale does for ASCII and reject every byte >= 0x80.
+constexpr auto is_ascii_space(char c) -> bool {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+constexpr auto is_ascii_digit(char c) -> bool {
+    return c >= '0' && c <= '9';
+}
+
+constexpr auto is_ascii_alpha(char c) -> bool {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr auto is_ascii_xdigit(char c) -> bool {
+    return is_ascii_digit(c) || (c >= 'a' && c <= 'f')
+           || (c >= 'A' && c <= 'F');
+}
+
+constexpr auto is_ident_start(char c) -> bool {
+    return is_ascii_alpha(c) || c == '_';
+}
+
+constexpr auto is_ident_continue(char c) -> bool {
+    return is_ascii_alpha(c) || is_ascii_digit(c) || c == '_';
+}
+
+/// A set of byte-run scanners.
+///
+/// Each scanner takes the half-open range `[p, end)` and returns a pointer to
+/// the first byte that does not belong to the run, or `end` if the whole
+/// range does.
+///
+/// The padded variants take no end pointer. They rely on a NUL byte that
+/// ends the run, followed by enough readable bytes for a whole vector block
+/// (see SourceText::PADDING), and read whole blocks without a scalar tail.
+struct ScanKernels {
+    using Scanner = auto (*)(const char* p, const char* end) -> const char*;
+    using PaddedScanner = auto (*)(const char* p) -> const char*;
+
+    const char* name;
+    Scanner whitespace;  // ' ', '\t', '\n', '\v', '\f', '\r'
+    Scanner ident_tail;  // [A-Za-z0-9_]
+    Scanner digits;      // [0-9]
+
+    PaddedScanner padded_whitespace;
+    PaddedScanner padded_ident_tail;
+    PaddedScanner padded_digits;
+};
+
+/// The fastest kernel set this CPU supports, picked by feature detection on
+/// first use and cached for the rest of the process.
+auto active_scan_kernels() -> const ScanKernels&;
+
+/// Every kernel set that can run on this CPU, scalar first.
+auto supported_scan_kernels() -> std::vector<ScanKernels>;
+
+#endif // SCAN_HH
@@ -0,0 +1,11 @@
+#ifndef UNICODE_XID_HH
+#define UNICODE_XID_HH
+
+#include "common.hh"
+
+/// Unicode identifier properties, answered from a generated two-stage
+/// table (see tools/gen_unicode_xid.py) of about 8 KiB.
+auto is_xid_start(u32 code_point) -> bool;
+auto is_xid_continue(u32 code_point) -> bool;
+
+#endif // UNICODE_XID_HH
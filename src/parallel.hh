@@ -0,0 +1,63 @@
+#ifndef PARALLEL_HH
+#define PARALLEL_HH
+
+#include "common.hh"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// Resolves a requested worker count; 0 means one per hardware thread.
+inline auto worker_count(usize requested) -> usize {
+    if (requested != 0) {
+        return requested;
+    }
+    return std::max<usize>(1, std::thread::hardware_concurrency());
+}
+
+/// Runs `body(worker, i)` for every i in [0, count) on up to `threads`
+/// workers, where `worker` in [0, worker_count(threads)) identifies the
+/// worker making the call. Calls with the same worker never overlap, so
+/// each worker can keep its own scratch state in a slot indexed by it.
+///
+/// Indices are handed out one at a time from a shared counter, so uneven
+/// items balance themselves. The calling thread takes part in the work as
+/// worker 0 and the call returns once every index has been processed.
+/// `body` must not throw.
+template <typename F>
+auto parallel_for_workers(usize count, usize threads, F&& body) -> void {
+    threads = std::min(worker_count(threads), count);
+    if (threads <= 1) {
+        for (usize i = 0; i < count; ++i) {
+            body(usize{0}, i);
+        }
+        return;
+    }
+
+    std::atomic<usize> next{0};
+    auto worker = [&](usize id) {
+        while (true) {
+            usize i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count) {
+                break;
+            }
+            body(id, i);
+        }
+    };
+
+    std::vector<std::jthread> pool;
+    pool.reserve(threads - 1);
+    for (usize t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+}
+
+/// Runs `body(i)` for every i in [0, count) on up to `threads` workers,
+/// as parallel_for_workers does.
+template <typename F>
+auto parallel_for(usize count, usize threads, F&& body) -> void {
+    parallel_for_workers(count, threads, [&](usize, usize i) { body(i); });
+}
+
+#endif // PARALLEL_HH
@@ -0,0 +1,245 @@
+#ifndef GRAMMAR_HH
+#define GRAMMAR_HH
+
+#include "common.hh"
+#include "lex/lex.hh"
+#include <array>
+#include <optional>
+#include <utility>
+
+// 编译期文法组合子：token 种类上的序列、选择与重复。
+//
+// 规则是只有静态成员的类型：
+//   FIRST     能开始该规则的 token 种类集合，按 TokenKind 索引
+//   NULLABLE  能否匹配空序列
+//   match     从 pos 开始匹配，成功时返回结束位置
+//
+// 集合与分派表都在编译期算出。Seq 展开为逐个 token 的比较，全部由单个
+// token 组成时只确认一次窗口再依次比较；Alt 用下一个 token 查一次分派表
+// 选中唯一可能的分支，不逐个尝试。选择要求各分支的 FIRST 互不相交（LL(1)），
+// 冲突在编译期报错。匹配是预测式的：分支一旦选定，失败不再回退到别的分支
+namespace grammar {
+
+inline constexpr usize TOKEN_KIND_COUNT
+    = static_cast<usize>(TokenKind::Eof) + 1;
+
+using TokenSet = std::array<bool, TOKEN_KIND_COUNT>;
+
+constexpr auto token_index(TokenKind kind) -> usize {
+    return static_cast<usize>(kind);
+}
+
+constexpr auto set_union(TokenSet set, const TokenSet& other) -> TokenSet {
+    for (usize i = 0; i < TOKEN_KIND_COUNT; ++i) {
+        set[i] = set[i] || other[i];
+    }
+    return set;
+}
+
+constexpr auto set_intersects(const TokenSet& set, const TokenSet& other)
+    -> bool {
+    for (usize i = 0; i < TOKEN_KIND_COUNT; ++i) {
+        if (set[i] && other[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 单个 token
+template <TokenKind K>
+struct Tok {
+    static constexpr TokenSet FIRST = [] {
+        TokenSet set{};
+        set[token_index(K)] = true;
+        return set;
+    }();
+    static constexpr bool NULLABLE = false;
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        if (tokens.has(pos) && tokens.kind(pos) == K) {
+            return pos + 1;
+        }
+        return std::nullopt;
+    }
+};
+
+// 依次匹配每条规则
+template <typename... Rules>
+struct Seq {
+    static constexpr TokenSet FIRST = [] {
+        TokenSet set{};
+        bool open = true; // 之前的规则都可以为空
+        ((open ? (set = set_union(set, Rules::FIRST),
+                  open = Rules::NULLABLE)
+               : false),
+         ...);
+        return set;
+    }();
+    static constexpr bool NULLABLE = (Rules::NULLABLE && ...);
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        std::optional<usize> end = pos;
+        ((end = Rules::match(tokens, *end)) && ...);
+        return end;
+    }
+};
+
+// 定长 token 序列：确认窗口一次，再与 token 种类数组逐项比较
+template <TokenKind... Ks>
+struct Seq<Tok<Ks>...> {
+    static constexpr usize WIDTH    = sizeof...(Ks);
+    static constexpr TokenSet FIRST = [] {
+        TokenSet set{};
+        if constexpr (WIDTH > 0) {
+            constexpr TokenKind first[] = {Ks...};
+            set[token_index(first[0])]  = true;
+        }
+        return set;
+    }();
+    static constexpr bool NULLABLE = WIDTH == 0;
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        if constexpr (WIDTH > 0) {
+            if (!tokens.has(pos + WIDTH - 1)) {
+                return std::nullopt;
+            }
+            auto kinds = tokens.kinds(pos, WIDTH);
+            return [&]<usize... I>(std::index_sequence<I...>) {
+                return ((kinds[I] == Ks) && ...);
+            }(std::make_index_sequence<WIDTH>{})
+                       ? std::optional<usize>(pos + WIDTH)
+                       : std::nullopt;
+        }
+        return pos;
+    }
+};
+
+// 各分支的 FIRST 两两不相交，且至多一个分支可以为空
+template <typename... Rules>
+consteval auto ll1() -> bool {
+    constexpr std::array<TokenSet, sizeof...(Rules)> firsts
+        = {Rules::FIRST...};
+    usize empty = (usize{Rules::NULLABLE} + ... + 0);
+    for (usize i = 0; i < firsts.size(); ++i) {
+        for (usize j = i + 1; j < firsts.size(); ++j) {
+            if (set_intersects(firsts[i], firsts[j])) {
+                return false;
+            }
+        }
+    }
+    return empty <= 1;
+}
+
+// 按下一个 token 在编译期分派表中选出唯一的分支。没有分支以它开头时
+// 选可以为空的分支（至多一个），否则匹配失败
+template <typename... Rules>
+struct Alt {
+    static_assert(sizeof...(Rules) < 255, "too many alternatives");
+
+    static constexpr TokenSet FIRST = [] {
+        TokenSet set{};
+        ((set = set_union(set, Rules::FIRST)), ...);
+        return set;
+    }();
+    static constexpr bool NULLABLE = (Rules::NULLABLE || ...);
+
+    // 可以为空的分支下标，没有时为 NONE
+    static constexpr u8 NONE  = sizeof...(Rules);
+    static constexpr u8 EMPTY = [] {
+        u8 index = NONE;
+        u8 i     = 0;
+        ((index = Rules::NULLABLE && index == NONE ? i : index, ++i), ...);
+        return index;
+    }();
+
+    static_assert(ll1<Rules...>(),
+                  "alternatives must have disjoint FIRST sets and at most "
+                  "one of them may be empty");
+
+    // 下一个 token 种类 -> 分支下标
+    static constexpr std::array<u8, TOKEN_KIND_COUNT> DISPATCH = [] {
+        std::array<u8, TOKEN_KIND_COUNT> table{};
+        table.fill(EMPTY);
+        u8 i = 0;
+        (
+            [&] {
+                for (usize kind = 0; kind < TOKEN_KIND_COUNT; ++kind) {
+                    if (Rules::FIRST[kind]) {
+                        table[kind] = i;
+                    }
+                }
+                ++i;
+            }(),
+            ...);
+        return table;
+    }();
+
+    // 以 kind 开头时选中的分支，NONE 表示没有
+    static constexpr auto dispatch(TokenKind kind) -> u8 {
+        return DISPATCH[token_index(kind)];
+    }
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        u8 chosen = tokens.has(pos) ? dispatch(tokens.kind(pos)) : EMPTY;
+        return [&]<usize... I>(std::index_sequence<I...>) {
+            std::optional<usize> end;
+            ((chosen == I && (end = Rules::match(tokens, pos), true)) || ...);
+            return end;
+        }(std::index_sequence_for<Rules...>{});
+    }
+};
+
+// 任一 token
+template <TokenKind... Ks>
+using OneOf = Alt<Tok<Ks>...>;
+
+// 可选：下一个 token 在 Rule 的 FIRST 中时匹配 Rule，否则匹配空序列
+template <typename Rule>
+struct Opt {
+    static constexpr TokenSet FIRST = Rule::FIRST;
+    static constexpr bool NULLABLE  = true;
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        if (tokens.has(pos) && FIRST[token_index(tokens.kind(pos))]) {
+            return Rule::match(tokens, pos);
+        }
+        return pos;
+    }
+};
+
+// 零次或多次重复，下一个 token 不在 FIRST 中时停止
+template <typename Rule>
+struct Rep {
+    static_assert(!Rule::NULLABLE, "repeated rule must consume a token");
+
+    static constexpr TokenSet FIRST = Rule::FIRST;
+    static constexpr bool NULLABLE  = true;
+
+    static auto match(const TokenStream& tokens, usize pos)
+        -> std::optional<usize> {
+        while (tokens.has(pos) && FIRST[token_index(tokens.kind(pos))]) {
+            auto end = Rule::match(tokens, pos);
+            if (!end) {
+                return std::nullopt;
+            }
+            pos = *end;
+        }
+        return pos;
+    }
+};
+
+// kind 能否开始 Rule：一次查表
+template <typename Rule>
+constexpr auto starts(TokenKind kind) -> bool {
+    return Rule::FIRST[token_index(kind)];
+}
+
+} // namespace grammar
+
+#endif // GRAMMAR_HH
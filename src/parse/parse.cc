@@ -1,4 +1,327 @@
 #include "parse/parse.hh"
+#include "parallel.hh"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+// 绑定力等级，从低到高。中缀运算符左结合：右绑定力 = 左绑定力 + 1
+enum Power : u8 {
+    POWER_NONE    = 0,
+    POWER_OR      = 2,
+    POWER_AND     = 4,
+    POWER_COMPARE = 6,
+    POWER_RANGE   = 8,
+    POWER_ADD     = 10,
+    POWER_MUL     = 12,
+    POWER_CAST    = 14,
+    POWER_PREFIX  = 16,
+};
+
+struct BindingPower {
+    u8 left       = POWER_NONE;
+    u8 right      = POWER_NONE;
+    NodeKind kind = NodeKind::Invalid;
+};
+
+using grammar::TOKEN_KIND_COUNT;
+
+// 中缀运算符表，按 TokenKind 索引；kind 为 Invalid 的 token 不是中缀运算符
+constexpr auto INFIX_POWER = [] {
+    std::array<BindingPower, TOKEN_KIND_COUNT> table{};
+    auto infix = [&](TokenKind token, Power power, NodeKind kind) {
+        table[static_cast<usize>(token)]
+            = BindingPower{power, static_cast<u8>(power + 1), kind};
+    };
+
+    infix(TokenKind::Or, POWER_OR, NodeKind::BoolOr);
+    infix(TokenKind::And, POWER_AND, NodeKind::BoolAnd);
+    infix(TokenKind::EqEq, POWER_COMPARE, NodeKind::BoolEq);
+    infix(TokenKind::BangEq, POWER_COMPARE, NodeKind::BoolNotEq);
+    infix(TokenKind::Lt, POWER_COMPARE, NodeKind::BoolLt);
+    infix(TokenKind::LtEq, POWER_COMPARE, NodeKind::BoolLtEq);
+    infix(TokenKind::Gt, POWER_COMPARE, NodeKind::BoolGt);
+    infix(TokenKind::GtEq, POWER_COMPARE, NodeKind::BoolGtEq);
+    infix(TokenKind::Plus, POWER_ADD, NodeKind::Add);
+    infix(TokenKind::Minus, POWER_ADD, NodeKind::Sub);
+    infix(TokenKind::PlusPlus, POWER_ADD, NodeKind::AddAdd);
+    infix(TokenKind::Star, POWER_MUL, NodeKind::Mul);
+    infix(TokenKind::Slash, POWER_MUL, NodeKind::Div);
+    infix(TokenKind::Percent, POWER_MUL, NodeKind::Mod);
+    infix(TokenKind::As, POWER_CAST, NodeKind::TypeCast);
+    return table;
+}();
+
+// 前缀运算符表：操作数以 POWER_PREFIX 解析
+constexpr auto PREFIX_KIND = [] {
+    std::array<NodeKind, TOKEN_KIND_COUNT> table{};
+    table[static_cast<usize>(TokenKind::Not)]       = NodeKind::BoolNot;
+    table[static_cast<usize>(TokenKind::Bang)]      = NodeKind::BoolNot;
+    table[static_cast<usize>(TokenKind::Minus)]     = NodeKind::Negate;
+    table[static_cast<usize>(TokenKind::Ampersand)] = NodeKind::Refer;
+    table[static_cast<usize>(TokenKind::Question)]  = NodeKind::OptionalType;
+    table[static_cast<usize>(TokenKind::Star)]      = NodeKind::PointerType;
+    return table;
+}();
+
+// 字面量与标识符对应的叶子节点
+constexpr auto PRIMARY_KIND = [] {
+    std::array<NodeKind, TOKEN_KIND_COUNT> table{};
+    table[static_cast<usize>(TokenKind::Id)]        = NodeKind::Id;
+    table[static_cast<usize>(TokenKind::Str)]       = NodeKind::Str;
+    table[static_cast<usize>(TokenKind::Int)]       = NodeKind::Int;
+    table[static_cast<usize>(TokenKind::IntBin)]    = NodeKind::Int;
+    table[static_cast<usize>(TokenKind::IntOct)]    = NodeKind::Int;
+    table[static_cast<usize>(TokenKind::IntHex)]    = NodeKind::Int;
+    table[static_cast<usize>(TokenKind::Real)]      = NodeKind::Real;
+    table[static_cast<usize>(TokenKind::RealSci)]   = NodeKind::Real;
+    table[static_cast<usize>(TokenKind::Char)]      = NodeKind::Char;
+    table[static_cast<usize>(TokenKind::True)]      = NodeKind::Bool;
+    table[static_cast<usize>(TokenKind::False)]     = NodeKind::Bool;
+    table[static_cast<usize>(TokenKind::Null)]      = NodeKind::Null;
+    table[static_cast<usize>(TokenKind::SelfLower)] = NodeKind::SelfLower;
+    table[static_cast<usize>(TokenKind::SelfCap)]   = NodeKind::SelfCap;
+    return table;
+}();
+
+auto infix_power(TokenKind kind) -> BindingPower {
+    return INFIX_POWER[static_cast<usize>(kind)];
+}
+
+auto prefix_kind(TokenKind kind) -> NodeKind {
+    return PREFIX_KIND[static_cast<usize>(kind)];
+}
+
+auto primary_kind(TokenKind kind) -> NodeKind {
+    return PRIMARY_KIND[static_cast<usize>(kind)];
+}
+
+// 能作为表达式第一个 token 的：字面量与标识符、前缀运算符、括号、
+// 列表和前缀区间 `..`
+using ExprStart = grammar::OneOf<TokenKind::Id,
+                                 TokenKind::Str,
+                                 TokenKind::Int,
+                                 TokenKind::IntBin,
+                                 TokenKind::IntOct,
+                                 TokenKind::IntHex,
+                                 TokenKind::Real,
+                                 TokenKind::RealSci,
+                                 TokenKind::Char,
+                                 TokenKind::True,
+                                 TokenKind::False,
+                                 TokenKind::Null,
+                                 TokenKind::SelfLower,
+                                 TokenKind::SelfCap,
+                                 TokenKind::Not,
+                                 TokenKind::Bang,
+                                 TokenKind::Minus,
+                                 TokenKind::Ampersand,
+                                 TokenKind::Question,
+                                 TokenKind::Star,
+                                 TokenKind::LParen,
+                                 TokenKind::LBracket,
+                                 TokenKind::Dot>;
+
+// FIRST 集须与前缀、基本表达式两张表一致
+static_assert([] {
+    for (usize i = 0; i < TOKEN_KIND_COUNT; ++i) {
+        auto kind     = static_cast<TokenKind>(i);
+        bool expected = PRIMARY_KIND[i] != NodeKind::Invalid
+                        || PREFIX_KIND[i] != NodeKind::Invalid
+                        || kind == TokenKind::LParen
+                        || kind == TokenKind::LBracket
+                        || kind == TokenKind::Dot;
+        if (grammar::starts<ExprStart>(kind) != expected) {
+            return false;
+        }
+    }
+    return true;
+}());
+
+// 能开始顶层条目的关键字。它们不能接在任何表达式或语句之后，
+// 所以在这里切分不会改变前一段的解析结果
+using ItemStart = grammar::OneOf<TokenKind::Fn,
+                                 TokenKind::Struct,
+                                 TokenKind::Enum,
+                                 TokenKind::Union,
+                                 TokenKind::Mod,
+                                 TokenKind::Use>;
+
+auto starts_expr(TokenKind kind) -> bool {
+    return grammar::starts<ExprStart>(kind);
+}
+
+auto starts_item(TokenKind kind) -> bool {
+    return grammar::starts<ItemStart>(kind);
+}
+
+// 在括号深度为 0 的条目关键字处切分，每段至少 min_tokens 个 token。
+// 返回各段起点，末尾附上 Eof 的下标
+auto split_items(const TokenBuffer& tokens, usize min_tokens)
+    -> std::vector<usize> {
+    std::vector<usize> cuts{0};
+    usize eof = tokens.size() - 1;
+    i64 depth = 0;
+    for (usize i = 0; i < eof; ++i) {
+        switch (tokens.kind(i)) {
+        case TokenKind::LParen:
+        case TokenKind::LBracket:
+        case TokenKind::LBrace:
+            ++depth;
+            break;
+        case TokenKind::RParen:
+        case TokenKind::RBracket:
+        case TokenKind::RBrace:
+            --depth;
+            break;
+        default:
+            if (depth == 0 && starts_item(tokens.kind(i))
+                && i - cuts.back() >= min_tokens && eof - i >= min_tokens) {
+                cuts.push_back(i);
+            }
+            break;
+        }
+    }
+    cuts.push_back(eof);
+    return cuts;
+}
+
+// 节点跨度覆盖的 token 下标区间 [first, last]
+struct TokenRange {
+    usize first;
+    usize last;
+};
+
+auto token_range(const TokenBuffer& tokens, Span span, u32 start_pos)
+    -> std::optional<TokenRange> {
+    if (span.end <= span.start || span.start < start_pos) {
+        return std::nullopt;
+    }
+    usize first = tokens.lower_bound_start(span.start - start_pos);
+    usize end   = tokens.lower_bound_start(span.end - start_pos, first);
+    if (first >= end) {
+        return std::nullopt;
+    }
+    return TokenRange{first, end - 1};
+}
+
+// 改动的 token 区间：旧序列的 [first, old_last) 换成新序列的 [first, new_last)
+struct EditRange {
+    usize first;
+    usize old_last;
+    usize new_last;
+};
+
+// relex 会重新扫描改动前后的几个 token，其中文本与位置都没变的不算改动，
+// 否则紧挨着的条目也会被卷进来。读不到源码文本时保持原样
+auto narrow_edit(const TokenBuffer& old_tokens, const RelexResult& edit)
+    -> EditRange {
+    const TokenBuffer& tokens = edit.tokens;
+    EditRange range{edit.first, edit.old_last, edit.new_last};
+    auto text = [](const TokenBuffer& buffer, usize i) -> std::string_view {
+        auto src = buffer.src();
+        if (buffer.end(i) > src.size()) {
+            return {};
+        }
+        return src.substr(buffer.start(i), buffer.end(i) - buffer.start(i));
+    };
+    auto same = [&](usize old_i, usize new_i) {
+        auto old_text = text(old_tokens, old_i);
+        return old_tokens.kind(old_i) == tokens.kind(new_i)
+               && !old_text.empty() && old_text == text(tokens, new_i);
+    };
+
+    while (range.first < range.old_last && range.first < range.new_last
+           && old_tokens.start(range.first) == tokens.start(range.first)
+           && same(range.first, range.first)) {
+        ++range.first;
+    }
+    // 改动之后的 token 统一平移 shift 字节
+    i64 shift = static_cast<i64>(tokens.start(edit.new_last))
+              - static_cast<i64>(old_tokens.start(edit.old_last));
+    while (range.old_last > range.first && range.new_last > range.first
+           && static_cast<i64>(tokens.start(range.new_last - 1))
+                      - static_cast<i64>(old_tokens.start(range.old_last - 1))
+                  == shift
+           && same(range.old_last - 1, range.new_last - 1)) {
+        --range.old_last;
+        --range.new_last;
+    }
+    return range;
+}
+
+// 增量重解析的单元：一个块或一个文件作用域条目
+struct ReparseUnit {
+    NodeIndex node;
+    TokenRange tokens;
+    bool block;
+};
+
+// 从文件作用域沿包含改动 [first, last) 的子节点向下，记下最深的、
+// `{` 与 `}` 都未改动的块；惰性块内部没有子节点，到此为止
+auto find_reparse_unit(const Ast& ast,
+                       const TokenBuffer& tokens,
+                       usize first,
+                       usize last,
+                       u32 start_pos) -> std::optional<ReparseUnit> {
+    auto covering = [&](NodeIndex node) -> std::optional<TokenRange> {
+        auto range = token_range(tokens, *ast.get_span(node), start_pos);
+        if (range && range->first <= first && first <= range->last
+            && last <= range->last + 1) {
+            return range;
+        }
+        return std::nullopt;
+    };
+
+    auto scope = ast.get_children(ast.root());
+    if (ast.get_node_kind(ast.root()) != NodeKind::FileScope
+        || scope.size() != 1) {
+        return std::nullopt;
+    }
+    std::optional<ReparseUnit> unit;
+    NodeIndex node = 0;
+    auto items = *ast.get_multi_child_slice(scope[0]);
+    for (NodeIndex item : items) {
+        if (auto range = covering(item)) {
+            unit = ReparseUnit{item, *range, false};
+            node = item;
+            break;
+        }
+    }
+
+    while (node != 0 && ast.get_node_kind(node) != NodeKind::LazyBlock) {
+        std::vector<NodeIndex> children;
+        NodeType type = get_node_type(*ast.get_node_kind(node));
+        auto direct   = ast.get_children(node);
+        for (usize i = 0; i < direct.size(); ++i) {
+            if (direct[i] != 0 && is_slice_child(type, i)) {
+                auto items = *ast.get_multi_child_slice(direct[i]);
+                children.insert(children.end(), items.begin(), items.end());
+            } else if (direct[i] != 0) {
+                children.push_back(direct[i]);
+            }
+        }
+
+        NodeIndex next = 0;
+        for (NodeIndex child : children) {
+            auto range = covering(child);
+            if (!range) {
+                continue;
+            }
+            NodeKind kind = *ast.get_node_kind(child);
+            if ((kind == NodeKind::Block || kind == NodeKind::LazyBlock)
+                && range->first < first && last <= range->last) {
+                unit = ReparseUnit{child, *range, true};
+            }
+            next = child;
+            break;
+        }
+        node = next;
+    }
+    return unit;
+}
+
+} // namespace
 
 // ScopedGuard 实现
 ScopedGuard::ScopedGuard(Parser* parser) : parser_(parser) {
@@ -19,39 +342,143 @@ void ParseError::emit(DiagCtxt& diag_ctx) const {
 }
 
 // Parser 实现
+Parser::Parser(const SourceMap* source_map, TokenBuffer tokens, u32 start_pos)
+    : source_map_(source_map), tokens_(std::move(tokens)), cursor_(0),
+      start_pos_(start_pos) {
+    enter(); // 初始化游标栈
+}
+
 Parser::Parser(const SourceMap* source_map,
-               std::vector<Token> tokens,
+               const std::vector<Token>& tokens,
                u32 start_pos)
-    : source_map_(source_map), tokens_(std::move(tokens)), cursor_(0),
+    : Parser(source_map, TokenBuffer(tokens), start_pos) {
+}
+
+Parser::Parser(const SourceMap* source_map,
+               Lexer lexer,
+               u32 start_pos,
+               TokenStorage storage)
+    : source_map_(source_map), tokens_(std::move(lexer), storage), cursor_(0),
       start_pos_(start_pos) {
     enter(); // 初始化游标栈
 }
 
+auto Parser::reset(TokenBuffer tokens, u32 start_pos, Ast ast) -> void {
+    tokens_    = TokenStream(std::move(tokens));
+    ast_       = std::move(ast);
+    cursor_    = 0;
+    start_pos_ = start_pos;
+    abandoned_ = false;
+    nesting_   = 0;
+    cursor_stack_.clear();
+    errors_.clear();
+    scratch_.clear();
+    expr_stack_.clear();
+    block_stack_.clear();
+    memo_.clear();
+    literals_ = nullptr;
+    enter();
+}
+
 auto Parser::parse(DiagCtxt& diag_ctx) -> void {
+    parse_file();
+    for (const ParseError& error : errors_) {
+        error.emit(diag_ctx);
+    }
+}
+
+auto Parser::parse_file() -> ParseResult {
     auto result = try_file_scope();
+    if (!errors_.empty()) {
+        return std::unexpected(errors_.front());
+    }
     if (result) {
         ast_.set_root(*result);
-    } else {
-        // 处理解析错误
-        result.error().emit(diag_ctx);
     }
+    return result;
 }
 
 auto Parser::parse_error(const ParseError& error) -> void {
-    // 这里可以处理错误，比如添加到错误列表或直接发射
-    // 暂时直接发射错误
-    DiagCtxt temp_diag_ctx;
-    const_cast<ParseError&>(error).emit(temp_diag_ctx);
+    errors_.push_back(error);
+}
+
+auto Parser::recover(const ParseError& error, usize start, bool in_block)
+    -> bool {
+    if (abandoned_) {
+        return false;
+    }
+    parse_error(error);
+    if (errors_.size() >= MAX_ERRORS) {
+        abandoned_ = true;
+        return false;
+    }
+    if (cursor_ == start && peek_next_token().kind != TokenKind::Eof) {
+        next_token();
+    }
+
+    usize depth = 0;
+    for (usize skipped = 0; skipped < MAX_RESYNC_TOKENS; ++skipped) {
+        TokenKind kind = peek_next_token().kind;
+        if (kind == TokenKind::Eof) {
+            return true;
+        }
+        if (depth == 0) {
+            if (kind == TokenKind::Semi) {
+                next_token();
+                return true;
+            }
+            if (kind == TokenKind::RBrace) {
+                if (!in_block) {
+                    next_token();
+                }
+                return true;
+            }
+            if (!in_block && starts_item(kind)) {
+                return true;
+            }
+        }
+        if (kind == TokenKind::LBrace) {
+            ++depth;
+        } else if (kind == TokenKind::RBrace) {
+            --depth;
+        }
+        next_token();
+    }
+
+    abandoned_ = true;
+    parse_error(ParseError(next_token_span(),
+                           "too many tokens skipped while recovering from "
+                           "syntax errors, parsing stops here",
+                           DiagLevel::Note));
+    return false;
 }
 
 auto Parser::enter() -> void {
-    cursor_stack_.push_back(cursor_);
+    u32 start = tokens_.has(cursor_) ? tokens_.start(cursor_) : 0;
+    cursor_stack_.push_back(Mark{cursor_, start});
 }
 
 auto Parser::exit() -> void {
     if (!cursor_stack_.empty()) {
         cursor_stack_.pop_back();
     }
+    release_tokens();
+}
+
+auto Parser::backtrack() -> void {
+    if (!cursor_stack_.empty()) {
+        cursor_ = cursor_stack_.back().index;
+    }
+}
+
+auto Parser::release_tokens() -> void {
+    // 构造函数压入的栈底记录从不回溯，只需保留 current_token 所需的上一个
+    // token 和栈中最早的记录之后的 token
+    usize floor = cursor_ == 0 ? 0 : cursor_ - 1;
+    if (cursor_stack_.size() > 1) {
+        floor = std::min(floor, cursor_stack_[1].index);
+    }
+    tokens_.release(floor);
 }
 
 auto Parser::finalize() -> Ast {
@@ -59,70 +486,71 @@ auto Parser::finalize() -> Ast {
 }
 
 auto Parser::peek(std::span<const TokenKind> expected) const -> bool {
-    if (cursor_ + expected.size() >= tokens_.size()) {
+    if (!tokens_.has(cursor_ + expected.size())) {
         return false;
     }
 
-    for (usize i = 0; i < expected.size(); ++i) {
-        if (tokens_[cursor_ + i].kind != expected[i]) {
-            return false;
-        }
-    }
-    return true;
+    auto kinds = tokens_.kinds(cursor_, expected.size());
+    return std::ranges::equal(kinds, expected);
 }
 
 auto Parser::eat_token(TokenKind expected) -> bool {
-    if (cursor_ >= tokens_.size()) {
+    if (!tokens_.has(cursor_)) {
         return false;
     }
 
-    if (tokens_[cursor_].kind == expected) {
+    if (tokens_.kind(cursor_) == expected) {
         ++cursor_;
+        release_tokens();
         return true;
     }
     return false;
 }
 
 auto Parser::eat_tokens(usize amount) -> void {
-    cursor_ += amount;
-    if (cursor_ > tokens_.size()) {
-        cursor_ = tokens_.size();
+    // 逐个确认，流式输入下在末尾截断
+    for (; amount > 0 && tokens_.has(cursor_); --amount) {
+        ++cursor_;
     }
+    release_tokens();
 }
 
 auto Parser::next_token() -> Token {
-    if (cursor_ >= tokens_.size()) {
+    if (!tokens_.has(cursor_)) {
         return Token(TokenKind::Eof, 0, 0);
     }
-    return tokens_[cursor_++];
+    Token token = tokens_.get(cursor_++);
+    release_tokens();
+    return token;
 }
 
 auto Parser::peek_next_token() const -> Token {
-    if (cursor_ >= tokens_.size()) {
+    if (!tokens_.has(cursor_)) {
         return Token(TokenKind::Eof, 0, 0);
     }
-    return tokens_[cursor_];
+    return tokens_.get(cursor_);
 }
 
 auto Parser::current_token() const -> Token {
-    if (cursor_ == 0 || cursor_ > tokens_.size()) {
+    if (cursor_ == 0 || !tokens_.has(cursor_ - 1)) {
         return Token(TokenKind::Sof, 0, 0);
     }
-    return tokens_[cursor_ - 1];
+    return tokens_.get(cursor_ - 1);
 }
 
+// 已释放的 token 与越界一样返回 Eof
 auto Parser::get_token(usize index) const -> Token {
-    if (index >= tokens_.size()) {
+    if (!tokens_.has(index)) {
         return Token(TokenKind::Eof, 0, 0);
     }
-    return tokens_[index];
+    return tokens_.get(index);
 }
 
 auto Parser::previous_token() const -> Token {
-    if (cursor_ == 0) {
+    if (cursor_ == 0 || !tokens_.has(cursor_ - 1)) {
         return Token(TokenKind::Sof, 0, 0);
     }
-    return tokens_[cursor_ - 1];
+    return tokens_.get(cursor_ - 1);
 }
 
 auto Parser::current_span() const -> Span {
@@ -131,38 +559,1119 @@ auto Parser::current_span() const -> Span {
                     0); // 返回空跨度
     }
 
-    usize start   = cursor_stack_.back();
+    u32 start_pos = cursor_stack_.back().start;
     usize end     = cursor_;
 
-    u32 start_pos = (start < tokens_.size()) ? tokens_[start].start : 0;
-    u32 end_pos
-        = (end < tokens_.size() && end > 0) ? tokens_[end - 1].end : start_pos;
+    u32 end_pos   = (end > 0 && tokens_.has(end) && tokens_.has(end - 1))
+                      ? tokens_.end(end - 1)
+                      : start_pos;
 
     return Span(start_pos, end_pos).with_offset(start_pos_);
 }
 
 auto Parser::next_token_span() const -> Span {
-    if (cursor_ >= tokens_.size()) {
+    if (!tokens_.has(cursor_)) {
         return Span(0, 0);
     }
 
-    const auto& token = tokens_[cursor_];
-    return Span(token.start, token.end).with_offset(start_pos_);
+    return Span(tokens_.start(cursor_), tokens_.end(cursor_))
+        .with_offset(start_pos_);
 }
 
 auto Parser::current_degree() const -> usize {
     return cursor_stack_.size();
 }
 
-// 解析方法实现（基础框架）
+auto parse_file_parallel(const SourceMap* source_map,
+                         const TokenBuffer& tokens,
+                         u32 start_pos,
+                         const ParallelParseOptions& options)
+    -> std::expected<Ast, ParseError> {
+    auto serial = [&]() -> std::expected<Ast, ParseError> {
+        Parser parser(source_map, tokens, start_pos);
+        parser.set_lazy_bodies(options.lazy_bodies);
+        auto result = parser.parse_file();
+        if (!result) {
+            return std::unexpected(result.error());
+        }
+        return parser.finalize();
+    };
+
+    usize threads = worker_count(options.threads);
+    if (threads <= 1 || tokens.size() <= 1) {
+        return serial();
+    }
+    // 段数取线程数的几倍，长短不一的段可以互相平衡
+    usize min_tokens = std::max(options.min_chunk_tokens,
+                                tokens.size() / (threads * 4));
+    auto cuts        = split_items(tokens, min_tokens);
+    usize chunks     = cuts.size() - 1;
+    if (chunks <= 1) {
+        return serial();
+    }
+
+    struct Fragment {
+        Ast ast;
+        std::vector<NodeIndex> items;
+        bool ok = false;
+    };
+    std::vector<Fragment> fragments(chunks);
+    parallel_for(chunks, threads, [&](usize i) {
+        TokenBuffer chunk = tokens.slice(cuts[i], cuts[i + 1]);
+        Parser parser(source_map, std::move(chunk), start_pos);
+        parser.set_lazy_bodies(options.lazy_bodies);
+        fragments[i].ok  = parser.parse_items(fragments[i].items).has_value();
+        fragments[i].ast = parser.finalize();
+    });
+
+    // 出错的文件串行重新解析，得到与串行完全一致的错误
+    if (!std::ranges::all_of(fragments, &Fragment::ok)) {
+        return serial();
+    }
+
+    // 按顺序追加片段，再像 try_file_scope 一样在最后生成 FileScope
+    Ast ast;
+    usize nodes = 0;
+    for (const Fragment& fragment : fragments) {
+        nodes += fragment.ast.nodes().size();
+    }
+    ast.reserve(nodes, 0);
+
+    std::vector<NodeIndex> items;
+    for (const Fragment& fragment : fragments) {
+        NodeIndex shift = ast.append(fragment.ast);
+        for (NodeIndex item : fragment.items) {
+            items.push_back(item + shift);
+        }
+    }
+    Span span(tokens.start(0) + start_pos,
+              tokens.end(cuts.back() - 1) + start_pos);
+    ast.set_root(
+        ast.add_node(NodeKind::FileScope, span, {ast.add_slice(items)}));
+    return ast;
+}
+
+ParseContext::ParseContext(const SourceMap* source_map)
+    : parser_(source_map, TokenBuffer(), 0) {
+}
+
+auto ParseContext::lex(const SourceText& text) -> const TokenBuffer& {
+    Lexer(text).tokenize_into(tokens_);
+    decode_literals(tokens_, literals_);
+    return tokens_;
+}
+
+auto ParseContext::parse(u32 start_pos)
+    -> std::expected<Ast, std::vector<ParseError>> {
+    auto count = static_cast<f64>(tokens_.size());
+    // 按上一个文件的比例多留 1/8，比例稍有起伏也不必扩容
+    Ast ast(static_cast<usize>(count * nodes_per_token_ * 1.125),
+            static_cast<usize>(count * children_per_token_ * 1.125));
+
+    parser_.reset(std::move(tokens_), start_pos, std::move(ast));
+    parser_.set_lazy_bodies(lazy_bodies_);
+    parser_.set_literals(&literals_);
+    auto result = parser_.parse_file();
+    tokens_     = parser_.take_tokens();
+    if (!result) {
+        return std::unexpected(parser_.take_errors());
+    }
+
+    ast = parser_.finalize();
+    if (count > 0) {
+        nodes_per_token_ = static_cast<f64>(ast.nodes().size()) / count;
+        children_per_token_
+            = static_cast<f64>(ast.child_storage_size()) / count;
+    }
+    return ast;
+}
+
+auto reparse(const SourceMap* source_map,
+             const Ast& old_ast,
+             const TokenBuffer& old_tokens,
+             const RelexResult& edit,
+             u32 start_pos,
+             bool lazy_bodies) -> std::expected<ReparseResult, ParseError> {
+    const TokenBuffer& tokens = edit.tokens;
+    auto full = [&]() -> std::expected<ReparseResult, ParseError> {
+        Parser parser(source_map, tokens, start_pos);
+        parser.set_lazy_bodies(lazy_bodies);
+        auto result = parser.parse_file();
+        if (!result) {
+            return std::unexpected(result.error());
+        }
+        ReparseResult out{parser.finalize(), {}};
+        auto old_nodes = static_cast<NodeIndex>(old_ast.nodes().size() - 1);
+        auto new_nodes = static_cast<NodeIndex>(out.ast.nodes().size() - 1);
+        out.replaced.push_back({1, old_nodes, 1, new_nodes});
+        return out;
+    };
+
+    EditRange range = narrow_edit(old_tokens, edit);
+    auto unit       = find_reparse_unit(
+        old_ast, old_tokens, range.first, range.old_last, start_pos);
+    if (!unit || unit->tokens.last + 1 + range.new_last <= range.old_last) {
+        return full();
+    }
+    auto first = old_ast.subtree_first(unit->node);
+    if (!first) {
+        return full();
+    }
+
+    // 单元在新 token 中的范围：起点在改动之前，终点随改动平移
+    usize new_first = unit->tokens.first;
+    usize new_last  = unit->tokens.last + range.new_last - range.old_last;
+    if (new_last < new_first) {
+        return full();
+    }
+    Parser parser(source_map, tokens.slice(new_first, new_last + 1), start_pos);
+    parser.set_lazy_bodies(lazy_bodies);
+    ParseResult result;
+    if (unit->block) {
+        bool lazy = old_ast.get_node_kind(unit->node) == NodeKind::LazyBlock;
+        result    = parser.parse_block(lazy);
+    } else {
+        std::vector<NodeIndex> items;
+        auto parsed = parser.parse_items(items);
+        if (!parsed || items.size() != 1) {
+            return full();
+        }
+        result = items[0];
+    }
+    if (!result || !parser.errors().empty()
+        || parser.peek_next_token().kind != TokenKind::Eof) {
+        return full();
+    }
+    Ast fragment = parser.finalize();
+    if (*result != fragment.nodes().size() - 1) {
+        return full();
+    }
+
+    // 单元之后的 token 整体平移；与单元同起点或同终点的祖先对齐到单元的
+    // 新起点或新终点
+    u32 old_start = old_tokens.start(unit->tokens.first) + start_pos;
+    u32 new_start = tokens.start(new_first) + start_pos;
+    u32 old_end   = old_tokens.end(unit->tokens.last) + start_pos;
+    u32 new_end   = tokens.end(new_last) + start_pos;
+    i64 shift   = static_cast<i64>(tokens.start(new_last + 1))
+              - static_cast<i64>(old_tokens.start(unit->tokens.last + 1));
+    auto moved  = [&](u32 pos) {
+        return static_cast<u32>(static_cast<i64>(pos) + shift);
+    };
+
+    ReparseResult out{old_ast, {}};
+    out.ast.remap_spans([&](Span span) {
+        if (span == Span() || span.end < span.start) {
+            return span; // 哨兵节点等无效跨度
+        }
+        u32 start = span.start >= old_end    ? moved(span.start)
+                  : span.start == old_start ? new_start
+                                            : span.start;
+        if (span.end == span.start) {
+            return Span(start, start);
+        }
+        u32 end = span.end > old_end    ? moved(span.end)
+                  : span.end == old_end ? new_end
+                                        : span.end;
+        return Span(start, end);
+    });
+    NodeIndex root = out.ast.splice(*first, unit->node, fragment);
+    out.replaced.push_back({*first, unit->node, *first, root});
+    return out;
+}
+
+auto remap_ast_spans(Ast& ast,
+                     const TokenBuffer& old_tokens,
+                     const TokenBuffer& new_tokens,
+                     u32 start_pos) -> void {
+    remap_ast_spans(ast, old_tokens, new_tokens, start_pos, start_pos);
+}
+
+auto remap_ast_spans(Ast& ast,
+                     const TokenBuffer& old_tokens,
+                     const TokenBuffer& new_tokens,
+                     u32 old_start_pos,
+                     u32 new_start_pos) -> void {
+    usize count = std::min(old_tokens.size(), new_tokens.size());
+
+    // 第一个起点不小于 pos 的 token，最多到 count
+    auto lower_bound = [&](u32 pos) -> usize {
+        return std::min(old_tokens.lower_bound_start(pos), count);
+    };
+
+    // 偏移落在第 i 个 token 内（或其后的空白中）时，随该 token 一起平移
+    auto map_start = [&](u32 pos) -> u32 {
+        usize next = lower_bound(pos + 1);
+        if (next == 0) {
+            return pos;
+        }
+        usize i = next - 1;
+        return new_tokens.start(i) + (pos - old_tokens.start(i));
+    };
+
+    // 跨度终点优先对齐到以它结束的 token，避免把 token 后新增的空白算入
+    auto map_end = [&](u32 pos) -> u32 {
+        usize next = lower_bound(pos);
+        if (next != 0) {
+            usize i = next - 1;
+            if (old_tokens.end(i) == pos) {
+                return new_tokens.end(i);
+            }
+        }
+        return map_start(pos);
+    };
+
+    ast.remap_spans([&](Span span) {
+        if (span == Span() || span.start < old_start_pos
+            || span.end < span.start) {
+            return span; // 哨兵节点等无效跨度
+        }
+        u32 start = map_start(span.start - old_start_pos);
+        u32 end   = span.end == span.start
+                      ? start
+                      : map_end(span.end - old_start_pos);
+        return Span(start, end).with_offset(new_start_pos);
+    });
+}
+
+PackratMemo::PackratMemo(usize capacity)
+    : slots_(capacity == 0 ? 0 : std::bit_ceil(capacity)) {
+}
+
+auto PackratMemo::slot(ParseRule rule, usize position) -> Entry& {
+    u64 key = (static_cast<u64>(position) << 8) | static_cast<u64>(rule);
+    key *= 0x9E3779B97F4A7C15; // Fibonacci 散列，高位最均匀
+    return slots_[(key >> 32) & (slots_.size() - 1)];
+}
+
+auto PackratMemo::find(ParseRule rule, usize position, usize& end)
+    -> std::optional<ParseResult> {
+    Entry& entry = slot(rule, position);
+    if (entry.result && entry.rule == rule && entry.position == position) {
+        ++stats_.hits;
+        stats_.saved_tokens += entry.end - position;
+        end = entry.end;
+        return entry.result;
+    }
+    ++stats_.misses;
+    return std::nullopt;
+}
+
+auto PackratMemo::store(ParseRule rule,
+                        usize position,
+                        usize end,
+                        const ParseResult& result) -> void {
+    Entry& entry = slot(rule, position);
+    if (entry.result) {
+        ++stats_.evictions;
+    }
+    entry = Entry{position, end, rule, result};
+}
+
+auto PackratMemo::clear() -> void {
+    for (Entry& entry : slots_) {
+        entry.result.reset();
+    }
+    stats_ = MemoStats{};
+}
+
+auto Parser::parse_expr() -> ParseResult {
+    return try_expr();
+}
+
+auto Parser::expected_error(std::string_view what) const -> ParseError {
+    TokenKind found = peek_next_token().kind;
+    if (found == TokenKind::Eof) {
+        return ParseError(next_token_span(),
+                          std::format("expected {}, found end of file", what),
+                          ParseErrorKind::UnexpectedEof);
+    }
+    return ParseError(next_token_span(),
+                      std::format("expected {}, found `{}`", what, found),
+                      ParseErrorKind::ExpectedToken);
+}
+
+auto Parser::add_leaf(NodeKind kind) -> NodeIndex {
+    Span span = next_token_span();
+    next_token();
+    return ast_.add_node(kind, span);
+}
+
+auto Parser::take_slice(usize base) -> NodeIndex {
+    NodeIndex slice = ast_.add_slice(std::span(scratch_).subspan(base));
+    scratch_.resize(base);
+    return slice;
+}
+
+auto Parser::span_from(u32 start) const -> Span {
+    return Span(start, previous_token().end + start_pos_);
+}
+
+// `..` 与 `..=` 由相邻的 `.`、`.`、`=` 组成
+auto Parser::peek_range_op() const -> std::optional<RangeOp> {
+    Token first  = get_token(cursor_);
+    Token second = get_token(cursor_ + 1);
+    if (first.kind != TokenKind::Dot || second.kind != TokenKind::Dot
+        || first.end != second.start) {
+        return std::nullopt;
+    }
+    Token third = get_token(cursor_ + 2);
+    if (third.kind == TokenKind::Eq && second.end == third.start) {
+        return RangeOp{3, true};
+    }
+    return RangeOp{2, false};
+}
+
+// 文件作用域：函数定义与语句的序列
 auto Parser::try_file_scope() -> ParseResult {
-    // 使用 RAII
-    // 守卫自动管理游标栈
-    auto guard = scoped_guard();
+    u32 start  = next_token_span().start;
+    usize base = scratch_.size();
+    while (peek_next_token().kind != TokenKind::Eof) {
+        usize item_start = cursor_;
+        usize mark       = scratch_.size();
+        auto item        = try_item();
+        if (item) {
+            scratch_.push_back(*item);
+            continue;
+        }
+        scratch_.resize(mark);
+        if (!recover(item.error(), item_start, false)) {
+            break;
+        }
+    }
+
+    Span span = scratch_.size() == base ? Span(start, start) : span_from(start);
+    return ast_.add_node(NodeKind::FileScope, span, {take_slice(base)});
+}
+
+auto Parser::parse_items(std::vector<NodeIndex>& items)
+    -> std::expected<void, ParseError> {
+    while (peek_next_token().kind != TokenKind::Eof) {
+        auto item = try_item();
+        if (!item) {
+            return std::unexpected(item.error());
+        }
+        items.push_back(*item);
+    }
+    if (!errors_.empty()) {
+        return std::unexpected(errors_.front());
+    }
+    return {};
+}
+
+auto Parser::try_item() -> ParseResult {
+    if (peek_next_token().kind == TokenKind::Fn) {
+        return try_function_def();
+    }
+    return try_statement();
+}
 
-    // 创建文件作用域节点
-    NodeBuilder builder(NodeKind::FileScope, current_span());
-    NodeIndex file_scope = ast_.add_node(builder);
+// `fn name(params) [-> type] { ... }`，子节点依次为名字、参数切片、
+// 返回类型（无则为 0）和函数体（Block，惰性模式下为 LazyBlock）
+auto Parser::try_function_def() -> ParseResult {
+    u32 start = next_token_span().start;
+    next_token();
+    if (peek_next_token().kind != TokenKind::Id) {
+        return std::unexpected(expected_error("function name"));
+    }
+    NodeIndex name = add_leaf(NodeKind::Id);
+
+    if (!eat_token(TokenKind::LParen)) {
+        return std::unexpected(expected_error("`(`"));
+    }
+    usize base = scratch_.size();
+    while (!eat_token(TokenKind::RParen)) {
+        auto param = try_param();
+        if (!param) {
+            scratch_.resize(base);
+            return param;
+        }
+        scratch_.push_back(*param);
+        if (!eat_token(TokenKind::Comma)) {
+            if (eat_token(TokenKind::RParen)) {
+                break;
+            }
+            scratch_.resize(base);
+            return std::unexpected(expected_error("`,` or `)`"));
+        }
+    }
+    NodeIndex params      = take_slice(base);
+
+    NodeIndex return_type = 0;
+    if (eat_token(TokenKind::Arrow)) {
+        auto type = try_expr();
+        if (!type) {
+            return type;
+        }
+        return_type = *type;
+    }
+
+    auto body = lazy_bodies_ ? skip_block() : try_block();
+    if (!body) {
+        return body;
+    }
+    return ast_.add_node(NodeKind::FunctionDef,
+                         span_from(start),
+                         {name, params, return_type, *body});
+}
+
+// 参数：`self` 或 `name: type`
+auto Parser::try_param() -> ParseResult {
+    TokenKind token = peek_next_token().kind;
+    if (token == TokenKind::SelfLower) {
+        return add_leaf(NodeKind::ParamSelf);
+    }
+    if (token != TokenKind::Id) {
+        return std::unexpected(expected_error("parameter"));
+    }
+
+    u32 start      = next_token_span().start;
+    NodeIndex name = add_leaf(NodeKind::Id);
+    if (!eat_token(TokenKind::Colon)) {
+        return std::unexpected(expected_error("`:`"));
+    }
+    auto type = try_expr();
+    if (!type) {
+        return type;
+    }
+    return ast_.add_node(NodeKind::ParamTyped, span_from(start), {name, *type});
+}
 
-    return file_scope;
+auto Parser::try_statement() -> ParseResult {
+    switch (peek_next_token().kind) {
+    case TokenKind::Let:
+        return try_let_statement();
+    case TokenKind::Return:
+        return try_return_statement();
+    case TokenKind::If:
+        return try_if_statement();
+    case TokenKind::LBrace:
+        return try_block();
+    default:
+        return try_expr_statement();
+    }
+}
+
+// `let name [: type] = value;`，子节点为名字、类型（无则为 0）和初值
+auto Parser::try_let_statement() -> ParseResult {
+    u32 start = next_token_span().start;
+    next_token();
+    if (peek_next_token().kind != TokenKind::Id) {
+        return std::unexpected(expected_error("variable name"));
+    }
+    NodeIndex name = add_leaf(NodeKind::Id);
+
+    NodeIndex type = 0;
+    if (eat_token(TokenKind::Colon)) {
+        auto annotation = try_expr();
+        if (!annotation) {
+            return annotation;
+        }
+        type = *annotation;
+    }
+
+    if (!eat_token(TokenKind::Eq)) {
+        return std::unexpected(expected_error("`=`"));
+    }
+    auto value = try_expr();
+    if (!value) {
+        return value;
+    }
+    if (!eat_token(TokenKind::Semi)) {
+        return std::unexpected(expected_error("`;`"));
+    }
+    return ast_.add_node(NodeKind::LetDecl,
+                         span_from(start),
+                         {name, type, *value});
+}
+
+// `return [value];`，没有返回值时子节点为 0
+auto Parser::try_return_statement() -> ParseResult {
+    u32 start = next_token_span().start;
+    next_token();
+    NodeIndex value = 0;
+    if (!eat_token(TokenKind::Semi)) {
+        auto expr = try_expr();
+        if (!expr) {
+            return expr;
+        }
+        if (!eat_token(TokenKind::Semi)) {
+            return std::unexpected(expected_error("`;`"));
+        }
+        value = *expr;
+    }
+    return ast_.add_node(NodeKind::ReturnStatement, span_from(start), {value});
+}
+
+// `if cond { ... } [else { ... } | else if ...]`，子节点为条件、
+// then 块和 else 分支（无则为 0）
+auto Parser::try_if_statement() -> ParseResult {
+    usize floor = block_stack_.size(); // 须在 open_if 压栈之前取得
+    return run_blocks(floor, open_if());
+}
+
+auto Parser::try_expr_statement() -> ParseResult {
+    u32 start = next_token_span().start;
+    auto expr = try_expr();
+    if (!expr) {
+        return expr;
+    }
+    if (!eat_token(TokenKind::Semi)) {
+        return std::unexpected(expected_error("`;`"));
+    }
+    return ast_.add_node(NodeKind::ExprStatement, span_from(start), {*expr});
+}
+
+auto Parser::try_block() -> ParseResult {
+    usize floor = block_stack_.size();
+    return run_blocks(floor, open_block(0));
+}
+
+auto Parser::nesting_error(std::string_view what) const -> ParseError {
+    return ParseError(
+        next_token_span(),
+        std::format(
+            "{} nested too deeply, the limit is {}", what, max_nesting_),
+        ParseErrorKind::NestingTooDeep);
+}
+
+auto Parser::open_block(NodeIndex replace) -> std::optional<ParseResult> {
+    if (peek_next_token().kind != TokenKind::LBrace) {
+        return std::unexpected(expected_error("`{`"));
+    }
+    if (nesting_ >= max_nesting_) {
+        return std::unexpected(nesting_error("block"));
+    }
+    u32 start = next_token_span().start;
+    next_token();
+    ++nesting_;
+    block_stack_.push_back(BlockFrame{.kind    = BlockFrame::Kind::Block,
+                                      .start   = start,
+                                      .base    = scratch_.size(),
+                                      .replace = replace});
+    return std::nullopt;
+}
+
+auto Parser::open_if() -> std::optional<ParseResult> {
+    if (nesting_ >= max_nesting_) {
+        return std::unexpected(nesting_error("`if`"));
+    }
+    u32 start = next_token_span().start;
+    next_token();
+    auto condition = try_expr();
+    if (!condition) {
+        return condition;
+    }
+    ++nesting_;
+    block_stack_.push_back(BlockFrame{.kind      = BlockFrame::Kind::Then,
+                                      .start     = start,
+                                      .condition = *condition});
+    return open_block(0);
+}
+
+// 块与 if 语句不递归：未完成的块和 if 记为 block_stack_ 上的帧，语句里的
+// 表达式由同样不递归的 try_expr 解析。结果交给栈顶等待它的帧，出错的
+// 语句由所在的块恢复，顺序和结果都与递归下降一致
+auto Parser::run_blocks(usize floor, std::optional<ParseResult> value)
+    -> ParseResult {
+    using Kind = BlockFrame::Kind;
+    auto pop   = [&] {
+        --nesting_;
+        block_stack_.pop_back();
+    };
+
+    while (true) {
+        if (!value) {
+            // 栈顶是块，解析下一条语句
+            BlockFrame& frame = block_stack_.back();
+            if (eat_token(TokenKind::RBrace)) {
+                NodeIndex items   = take_slice(frame.base);
+                Span span         = span_from(frame.start);
+                NodeIndex replace = frame.replace;
+                pop();
+                if (replace != 0) {
+                    ast_.replace_node(replace, NodeKind::Block, span, {items});
+                    value = replace;
+                } else {
+                    value = ast_.add_node(NodeKind::Block, span, {items});
+                }
+                continue;
+            }
+            if (peek_next_token().kind == TokenKind::Eof) {
+                scratch_.resize(frame.base);
+                value = std::unexpected(expected_error("`}`"));
+                pop();
+                continue;
+            }
+            frame.statement = cursor_;
+            frame.mark      = scratch_.size();
+            switch (peek_next_token().kind) {
+            case TokenKind::LBrace:
+                value = open_block(0);
+                break;
+            case TokenKind::If:
+                value = open_if();
+                break;
+            default:
+                value = try_statement();
+                break;
+            }
+            continue;
+        }
+
+        if (block_stack_.size() == floor) {
+            return *value;
+        }
+        BlockFrame& frame = block_stack_.back();
+        switch (frame.kind) {
+        case Kind::Block:
+            if (*value) {
+                scratch_.push_back(**value);
+                value.reset();
+                continue;
+            }
+            scratch_.resize(frame.mark);
+            if (recover(value->error(), frame.statement, true)) {
+                value.reset();
+                continue;
+            }
+            scratch_.resize(frame.base);
+            pop();
+            continue;
+
+        case Kind::Then:
+            if (!*value) {
+                pop();
+                continue;
+            }
+            frame.then = **value;
+            if (!eat_token(TokenKind::Else)) {
+                NodeIndex node
+                    = ast_.add_node(NodeKind::IfStatement,
+                                    span_from(frame.start),
+                                    {frame.condition, frame.then, 0});
+                pop();
+                value = node;
+                continue;
+            }
+            frame.kind = Kind::Else;
+            value      = peek_next_token().kind == TokenKind::If
+                           ? open_if()
+                           : open_block(0);
+            continue;
+
+        case Kind::Else:
+            if (*value) {
+                value = ast_.add_node(NodeKind::IfStatement,
+                                      span_from(frame.start),
+                                      {frame.condition, frame.then, **value});
+            }
+            pop();
+            continue;
+        }
+    }
+}
+
+// 只看 token 种类，不建子节点，也不经过记忆表
+auto Parser::skip_block() -> ParseResult {
+    u32 start = next_token_span().start;
+    if (!eat_token(TokenKind::LBrace)) {
+        return std::unexpected(expected_error("`{`"));
+    }
+    for (usize depth = 1; depth > 0;) {
+        if (!tokens_.has(cursor_) || tokens_.kind(cursor_) == TokenKind::Eof) {
+            return std::unexpected(ParseError(Span(start, start + 1),
+                                              "unclosed `{`",
+                                              ParseErrorKind::MissingBrace));
+        }
+        switch (tokens_.kind(cursor_++)) {
+        case TokenKind::LBrace:
+            ++depth;
+            break;
+        case TokenKind::RBrace:
+            --depth;
+            break;
+        default:
+            break;
+        }
+        release_tokens();
+    }
+    return ast_.add_node(NodeKind::LazyBlock, span_from(start));
+}
+
+auto Parser::parse_block(bool lazy) -> ParseResult {
+    return lazy ? skip_block() : try_block();
+}
+
+auto Parser::expand_block(NodeIndex lazy) -> ParseResult {
+    usize floor = block_stack_.size();
+    auto result = run_blocks(floor, open_block(lazy));
+    if (result && !errors_.empty()) {
+        return std::unexpected(errors_.front());
+    }
+    return result;
+}
+
+auto expand_function_body(Ast& ast,
+                          const SourceMap& source_map,
+                          NodeIndex function) -> ParseResult {
+    auto children = ast.get_children(function);
+    if (ast.get_node_kind(function) != NodeKind::FunctionDef
+        || children.size() != 4) {
+        Span span = ast.get_span(function).value_or(Span());
+        return std::unexpected(ParseError(span, "not a function definition"));
+    }
+    NodeIndex body = children[3];
+    if (ast.get_node_kind(body) != NodeKind::LazyBlock) {
+        return body;
+    }
+
+    Span span              = *ast.get_span(body);
+    const SourceFile* file = source_map.file_at(span.start);
+    if (!file) {
+        return std::unexpected(
+            ParseError(span, "function body source is not loaded"));
+    }
+    auto text = file->content.substr(span.start - file->start_pos, span.len());
+
+    // 函数体的 token 从 0 开始计数，以 span.start 为起始偏移即得全局跨度
+    Parser parser(&source_map, Lexer(text).tokenize_all(), span.start);
+    parser.adopt_ast(std::move(ast));
+    auto result = parser.expand_block(body);
+    ast         = parser.finalize();
+    return result;
+}
+
+// Pratt 解析：前缀部分解析出左操作数后，只要下一个运算符的左绑定力
+// 不低于 min_power 就继续向右结合。
+//
+// 不递归：每个等待子表达式的调用记为 expr_stack_ 上的一帧，子表达式的
+// 结果交给栈顶的帧继续处理。嵌套再深，原生栈的用量也不变，每个 token
+// 只处理常数次。记忆表的查找和写入发生在与递归实现相同的位置：
+// 完整表达式（min_power 为 0）和基本表达式，失败同样被记忆
+auto Parser::try_expr(u8 min_power) -> ParseResult {
+    using Kind               = ExprFrame::Kind;
+    constexpr usize NO_MEMO  = static_cast<usize>(-1);
+    usize floor              = expr_stack_.size();
+    bool operand             = true; // 需要在 power 处开始一个新的操作数
+    u8 power                 = min_power;
+    ParseResult value        = NodeIndex{0};
+
+    auto push = [&](const ExprFrame& frame) -> bool {
+        if (frame.kind == Kind::Operand) {
+            if (nesting_ >= max_nesting_) {
+                value = std::unexpected(nesting_error("expression"));
+                return false;
+            }
+            ++nesting_;
+        }
+        expr_stack_.push_back(frame);
+        return true;
+    };
+    auto pop = [&] {
+        if (expr_stack_.back().kind == Kind::Operand) {
+            --nesting_;
+        }
+        expr_stack_.pop_back();
+    };
+    auto start_operand = [&](u8 at) {
+        operand = true;
+        power   = at;
+    };
+    // 栈顶是列表帧：收尾，写成 ListOf、Tuple 或 Call 节点
+    auto finish_list = [&] {
+        ExprFrame list  = expr_stack_.back();
+        NodeIndex items = take_slice(list.base);
+        pop();
+        value = list.node == NodeKind::Call
+                  ? ast_.add_node(list.node,
+                                  span_from(list.start),
+                                  {list.lhs, items})
+                  : ast_.add_node(list.node, span_from(list.start), {items});
+    };
+    auto next_list_item = [&] {
+        if (eat_token(expr_stack_.back().close)) {
+            finish_list();
+        } else {
+            start_operand(POWER_NONE);
+        }
+    };
+
+    while (true) {
+        if (operand) {
+            operand          = false;
+            usize memo_start = NO_MEMO;
+            if (power == POWER_NONE && memo_.enabled()) {
+                usize end = 0;
+                if (auto hit = memo_.find(ParseRule::Expr, cursor_, end)) {
+                    cursor_ = end;
+                    value   = *hit;
+                    continue;
+                }
+                memo_start = cursor_;
+            }
+            if (!push({.kind      = Kind::Operand,
+                       .min_power = power,
+                       .base      = memo_start})) {
+                continue;
+            }
+
+            if (auto range = peek_range_op()) {
+                u32 start = next_token_span().start;
+                eat_tokens(range->length);
+                if (starts_expr(peek_next_token().kind)) {
+                    push({.kind      = Kind::Range,
+                          .inclusive = range->inclusive,
+                          .start     = start});
+                    start_operand(POWER_RANGE + 1);
+                } else if (range->inclusive) {
+                    value = std::unexpected(
+                        expected_error("range end after `..=`"));
+                } else {
+                    value = ast_.add_node(NodeKind::RangeFull,
+                                          span_from(start));
+                }
+                continue;
+            }
+
+            TokenKind token = peek_next_token().kind;
+            if (NodeKind kind = prefix_kind(token); kind != NodeKind::Invalid) {
+                u32 start = next_token_span().start;
+                next_token();
+                push({.kind = Kind::Prefix, .node = kind, .start = start});
+                start_operand(POWER_PREFIX);
+                continue;
+            }
+
+            // 基本表达式，之后由 Postfix 帧处理后缀运算
+            if (memo_.enabled()) {
+                usize end = 0;
+                auto hit = memo_.find(ParseRule::PrimaryExpr, cursor_, end);
+                if (hit) {
+                    cursor_ = end;
+                    push({.kind = Kind::Primary, .base = NO_MEMO});
+                    value = *hit;
+                    continue;
+                }
+            }
+            push({.kind = Kind::Primary,
+                  .base = memo_.enabled() ? cursor_ : NO_MEMO});
+            if (NodeKind leaf = primary_kind(token);
+                leaf != NodeKind::Invalid) {
+                auto literal = literals_ != nullptr ? literals_->find(cursor_)
+                                                    : std::nullopt;
+                if (literal && !literals_->is_valid(*literal)) {
+                    value = std::unexpected(
+                        ParseError(next_token_span(),
+                                   "invalid literal",
+                                   ParseErrorKind::InvalidToken));
+                    continue;
+                }
+                value = add_leaf(leaf);
+                continue;
+            }
+            u32 start = next_token_span().start;
+            if (token == TokenKind::LBracket) {
+                next_token();
+                push({.kind  = Kind::List,
+                      .close = TokenKind::RBracket,
+                      .node  = NodeKind::ListOf,
+                      .start = start,
+                      .base  = scratch_.size()});
+                next_list_item();
+                continue;
+            }
+            if (token != TokenKind::LParen) {
+                value = std::unexpected(expected_error("expression"));
+                continue;
+            }
+            next_token();
+            if (eat_token(TokenKind::RParen)) {
+                value = ast_.add_node(NodeKind::Unit, span_from(start));
+                continue;
+            }
+            push({.kind = Kind::Paren, .start = start});
+            start_operand(POWER_NONE);
+            continue;
+        }
+
+        if (expr_stack_.size() == floor) {
+            return value;
+        }
+        ExprFrame frame = expr_stack_.back();
+        if (!value) {
+            // 逐帧退出，与递归调用依次返回一样写入记忆表、弹出暂存
+            if (frame.kind == Kind::Operand && frame.base != NO_MEMO) {
+                memo_.store(ParseRule::Expr, frame.base, cursor_, value);
+            } else if (frame.kind == Kind::Primary && frame.base != NO_MEMO) {
+                memo_.store(ParseRule::PrimaryExpr, frame.base, cursor_, value);
+            } else if (frame.kind == Kind::List) {
+                scratch_.resize(frame.base);
+            }
+            pop();
+            continue;
+        }
+
+        NodeIndex node = *value;
+        switch (frame.kind) {
+        case Kind::Operand: {
+            if (auto range = peek_range_op()) {
+                if (POWER_RANGE < frame.min_power) {
+                    break;
+                }
+                u32 start = ast_.get_span(node)->start;
+                eat_tokens(range->length);
+                if (starts_expr(peek_next_token().kind)) {
+                    push({.kind      = Kind::Range,
+                          .inclusive = range->inclusive,
+                          .start     = start,
+                          .lhs       = node});
+                    start_operand(POWER_RANGE + 1);
+                } else if (range->inclusive) {
+                    value = std::unexpected(
+                        expected_error("range end after `..=`"));
+                } else {
+                    value = ast_.add_node(NodeKind::RangeFrom,
+                                          span_from(start),
+                                          {node});
+                }
+                continue;
+            }
+            BindingPower infix = infix_power(peek_next_token().kind);
+            if (infix.kind == NodeKind::Invalid
+                || infix.left < frame.min_power) {
+                break;
+            }
+            next_token();
+            push({.kind = Kind::Infix, .node = infix.kind, .lhs = node});
+            start_operand(infix.right);
+            continue;
+        }
+
+        case Kind::Infix: {
+            Span span(ast_.get_span(frame.lhs)->start,
+                      ast_.get_span(node)->end);
+            pop();
+            value = ast_.add_node(frame.node, span, {frame.lhs, node});
+            continue;
+        }
+
+        case Kind::Prefix:
+            pop();
+            value = ast_.add_node(frame.node, span_from(frame.start), {node});
+            continue;
+
+        case Kind::Range: {
+            pop();
+            if (frame.lhs != 0) {
+                NodeKind kind = frame.inclusive ? NodeKind::RangeFromToInclusive
+                                                : NodeKind::RangeFromTo;
+                value         = ast_.add_node(kind,
+                                      span_from(frame.start),
+                                      {frame.lhs, node});
+            } else {
+                NodeKind kind = frame.inclusive ? NodeKind::RangeToInclusive
+                                                : NodeKind::RangeTo;
+                value = ast_.add_node(kind, span_from(frame.start), {node});
+            }
+            continue;
+        }
+
+        case Kind::Primary:
+            if (frame.base != NO_MEMO) {
+                memo_.store(ParseRule::PrimaryExpr, frame.base, cursor_, value);
+            }
+            pop();
+            push({.kind = Kind::Postfix, .start = ast_.get_span(node)->start});
+            continue;
+
+        // 后缀运算：调用、下标、字段选择 `.name` / `.0`、解引用 `.*`
+        case Kind::Postfix: {
+            TokenKind token = peek_next_token().kind;
+            if (token == TokenKind::LParen) {
+                next_token();
+                push({.kind  = Kind::List,
+                      .close = TokenKind::RParen,
+                      .node  = NodeKind::Call,
+                      .start = frame.start,
+                      .lhs   = node,
+                      .base  = scratch_.size()});
+                next_list_item();
+                continue;
+            }
+            if (token == TokenKind::LBracket) {
+                next_token();
+                push({.kind = Kind::Index, .start = frame.start, .lhs = node});
+                start_operand(POWER_NONE);
+                continue;
+            }
+            if (token != TokenKind::Dot || peek_range_op()) {
+                pop();
+                continue;
+            }
+            next_token();
+            TokenKind member = peek_next_token().kind;
+            if (member == TokenKind::Star) {
+                next_token();
+                value = ast_.add_node(NodeKind::Deref,
+                                      span_from(frame.start),
+                                      {node});
+            } else if (member == TokenKind::Id || member == TokenKind::Int) {
+                NodeIndex field = add_leaf(primary_kind(member));
+                value           = ast_.add_node(NodeKind::Select,
+                                      span_from(frame.start),
+                                      {node, field});
+            } else {
+                value = std::unexpected(expected_error("field name"));
+            }
+            continue;
+        }
+
+        case Kind::Paren:
+            if (eat_token(TokenKind::RParen)) {
+                pop(); // 括号只影响结合
+            } else if (eat_token(TokenKind::Comma)) {
+                pop();
+                push({.kind  = Kind::List,
+                      .close = TokenKind::RParen,
+                      .node  = NodeKind::Tuple,
+                      .start = frame.start,
+                      .base  = scratch_.size()});
+                scratch_.push_back(node);
+                next_list_item();
+            } else {
+                value = std::unexpected(expected_error("`,` or `)`"));
+            }
+            continue;
+
+        case Kind::List:
+            scratch_.push_back(node);
+            if (eat_token(TokenKind::Comma)) {
+                next_list_item();
+            } else if (eat_token(frame.close)) {
+                finish_list();
+            } else {
+                value = std::unexpected(
+                    expected_error(std::format("`,` or `{}`", frame.close)));
+            }
+            continue;
+
+        case Kind::Index:
+            if (!eat_token(TokenKind::RBracket)) {
+                value = std::unexpected(expected_error("`]`"));
+                continue;
+            }
+            pop();
+            value = ast_.add_node(NodeKind::IndexCall,
+                                  span_from(frame.start),
+                                  {frame.lhs, node});
+            continue;
+        }
+
+        // Operand 帧遇到绑定力不足的运算符：这一层表达式到此结束
+        if (frame.base != NO_MEMO) {
+            memo_.store(ParseRule::Expr, frame.base, cursor_, value);
+        }
+        pop();
+    }
 }
@@ -4,10 +4,13 @@
 #include "common.hh"
 #include "ast/ast.hh"
 #include "lex/lex.hh"
+#include "lex/literal.hh"
 #include "source_map/source_map.hh"
 #include "diag/diag.hh"
+#include "parse/grammar.hh"
 #include <vector>
 #include <expected>
+#include <optional>
 
 // 解析错误种类枚举
 enum class ParseErrorKind {
@@ -21,6 +24,7 @@ enum class ParseErrorKind {
     UnexpectedEof,
 
     InternalError,
+    NestingTooDeep,
 };
 
 // 解析错误类型
@@ -49,6 +53,58 @@ class ParseError : public Issue {
 }; // 解析结果类型
 using ParseResult = std::expected<NodeIndex, ParseError>;
 
+// 可记忆的解析规则，与 token 位置一起作为 packrat 记忆表的键
+enum class ParseRule : u8 {
+    Expr,
+    PrimaryExpr,
+};
+
+// 记忆表计数器
+struct MemoStats {
+    usize hits         = 0; // 命中次数，每次命中省去一次重新解析
+    usize misses       = 0;
+    usize evictions    = 0; // 因槽位冲突被替换的记录
+    usize saved_tokens = 0; // 命中时直接跳过的 token 数
+};
+
+// Packrat 记忆表：(规则, token 位置) -> (结果, 结束位置)。
+// 直接映射的定长槽位，冲突时新记录替换旧记录，内存上限即容量
+class PackratMemo {
+  private:
+    struct Entry {
+        usize position = 0;
+        usize end      = 0;
+        ParseRule rule = ParseRule::Expr;
+        std::optional<ParseResult> result; // 空表示槽位未占用
+    };
+
+    std::vector<Entry> slots_;
+    MemoStats stats_;
+
+    auto slot(ParseRule rule, usize position) -> Entry&;
+
+  public:
+    // capacity 为 0 时禁用，否则向上取整为 2 的幂
+    explicit PackratMemo(usize capacity = 0);
+
+    auto enabled() const -> bool {
+        return !slots_.empty();
+    }
+
+    // 命中时返回结果并把结束位置写入 end
+    auto find(ParseRule rule, usize position, usize& end)
+        -> std::optional<ParseResult>;
+    auto store(ParseRule rule,
+               usize position,
+               usize end,
+               const ParseResult& result) -> void;
+    auto clear() -> void;
+
+    auto stats() const -> const MemoStats& {
+        return stats_;
+    }
+};
+
 // 前向声明
 class Parser;
 
@@ -73,28 +129,197 @@ class ScopedGuard {
 // 手写 PEG 解析器
 class Parser {
   private:
+    // 游标栈记录：token 下标及其起始偏移。
+    // 记下偏移后，计算跨度时不再需要已释放的 token
+    struct Mark {
+        usize index;
+        u32 start;
+    };
+
+    // 表达式工作栈的帧：递归下降中一个等待子表达式的调用
+    struct ExprFrame {
+        enum class Kind : u8 {
+            Operand, // 操作数及其后的中缀、区间运算，绑定力不低于 min_power
+            Infix,   // 等待右操作数
+            Prefix,  // 等待前缀运算的操作数
+            Range,   // 等待区间终点，lhs 为 0 时是前缀区间
+            Primary, // 等待基本表达式，之后转入 Postfix
+            Postfix, // 对 lhs 做后缀运算
+            Paren,   // `(` 之后的第一个表达式
+            List,    // 列表、元组或调用参数的元素
+            Index,   // `[` 之后的下标
+        };
+        Kind kind;
+        u8 min_power    = 0;
+        bool inclusive  = false;
+        TokenKind close = TokenKind::Eof;
+        NodeKind node   = NodeKind::Invalid;
+        u32 start       = 0;
+        NodeIndex lhs   = 0;
+        // List：元素在 scratch_ 中的起点；Operand、Primary：记忆表位置
+        usize base      = 0;
+    };
+
+    // 块工作栈的帧：未完成的块或 if 语句
+    struct BlockFrame {
+        enum class Kind : u8 {
+            Block, // 逐条解析语句直到 `}`
+            Then,  // 等待 then 块
+            Else,  // 等待 else 分支
+        };
+        Kind kind;
+        u32 start           = 0;
+        usize base          = 0; // 本块语句在 scratch_ 中的起点
+        usize statement     = 0; // 当前语句的起始 token，用于错误恢复
+        usize mark          = 0; // 当前语句开始时 scratch_ 的大小
+        NodeIndex condition = 0;
+        NodeIndex then      = 0;
+        NodeIndex replace   = 0; // 非 0 时块原地改写这个节点
+    };
+
     const SourceMap* source_map_;
-    std::vector<Token> tokens_;
+    TokenStream tokens_;
     Ast ast_;
     usize cursor_;
-    std::vector<usize> cursor_stack_;
+    std::vector<Mark> cursor_stack_;
     u32 start_pos_;
     std::vector<ParseError> errors_;
+    PackratMemo memo_;
+    // 收集多子节点的暂存栈，嵌套的列表各自占用栈顶一段，
+    // 复用同一块内存，构造节点时不再分配
+    std::vector<NodeIndex> scratch_;
+    // 当前 token 的字面量值，按 token 下标 O(1) 查找；为空时不检查字面量
+    const LiteralPool* literals_ = nullptr;
+    bool lazy_bodies_            = false;
+    // 恢复已放弃：错误数到达上限，或一次同步跳过的 token 过多
+    bool abandoned_   = false;
+    // 表达式与块的显式工作栈，在堆上增长，嵌套再深也不占用原生栈
+    std::vector<ExprFrame> expr_stack_;
+    std::vector<BlockFrame> block_stack_;
+    usize nesting_     = 0;
+    usize max_nesting_ = DEFAULT_MAX_NESTING;
 
   public:
+    // 一次同步最多跳过的 token 数。畸形区域再长，恢复的代价也有上限
+    static constexpr usize MAX_RESYNC_TOKENS   = 4096;
+    // 收集到这么多错误后停止解析
+    static constexpr usize MAX_ERRORS          = 100;
+    // 默认的嵌套上限：同时未完成的表达式操作数、块和 if 语句的总数
+    static constexpr usize DEFAULT_MAX_NESTING = 256 * 1024;
+
+    Parser(const SourceMap* source_map, TokenBuffer tokens, u32 start_pos);
+
     Parser(const SourceMap* source_map,
-           std::vector<Token> tokens,
+           const std::vector<Token>& tokens,
            u32 start_pos);
 
-    // 主解析方法
+    // 流式构造：边解析边从 lexer 拉取 token，不物化完整的 token 序列
+    Parser(const SourceMap* source_map,
+           Lexer lexer,
+           u32 start_pos,
+           TokenStorage storage = TokenStorage::Full);
+
+    // 改为解析另一份 token，状态与新构造的 Parser 相同（选项除外），
+    // 游标栈、错误表和各暂存栈只清空，保留容量。新节点写入 ast。
+    // 字面量池属于旧 token，一并解除
+    auto reset(TokenBuffer tokens, u32 start_pos, Ast ast = Ast()) -> void;
+
+    // 取回 token 数组以复用其容量，此后 Parser 不再持有 token
+    auto take_tokens() -> TokenBuffer {
+        return tokens_.take_buffer();
+    }
+
+    // 主解析方法：解析整个文件，再把收集到的全部错误按出现顺序
+    // 成批发射到 diag_ctx
     auto parse(DiagCtxt& diag_ctx) -> void;
 
-    // 错误处理
+    // 解析整个文件。出错的条目和语句记入 errors()，跳到同步点
+    // （`;`、`}`、条目关键字）后继续，一遍找出所有语法错误；
+    // 没有错误时设置 AST 根节点，否则返回第一个错误。
+    // 不接触 DiagCtxt，多个线程上的 Parser 可以各自调用
+    auto parse_file() -> ParseResult;
+
+    // 解析到 Eof 为止的条目序列，不生成 FileScope；条目节点追加到 items。
+    // 顶层条目出错即返回，块内的错误恢复后也以第一个错误返回
+    auto parse_items(std::vector<NodeIndex>& items)
+        -> std::expected<void, ParseError>;
+
+    // 错误处理：记入 errors()
     auto parse_error(const ParseError& error) -> void;
 
+    // 已收集的错误，按出现顺序
+    auto errors() const -> std::span<const ParseError> {
+        return errors_;
+    }
+
+    auto take_errors() -> std::vector<ParseError> {
+        return std::move(errors_);
+    }
+
     // 游标栈管理
     auto enter() -> void;
     auto exit() -> void;
+    // 回溯到最近一次 enter 时的位置
+    auto backtrack() -> void;
+
+    // 启用 packrat 记忆，最多保留 capacity 条记录；0 表示禁用
+    auto enable_memo(usize capacity) -> void {
+        memo_ = PackratMemo(capacity);
+    }
+
+    auto memo_stats() const -> const MemoStats& {
+        return memo_.stats();
+    }
+
+    // 按 (rule, 当前位置) 记忆 parse 的结果。命中时直接跳到记录的结束
+    // 位置，回溯后重新尝试同一规则不会重复解析
+    template <typename F>
+    auto memoized(ParseRule rule, F&& parse) -> ParseResult {
+        if (!memo_.enabled()) {
+            return parse();
+        }
+        usize position = cursor_;
+        usize end      = 0;
+        if (auto hit = memo_.find(rule, position, end)) {
+            cursor_ = end;
+            return *hit;
+        }
+        ParseResult result = parse();
+        memo_.store(rule, position, cursor_, result);
+        return result;
+    }
+
+    // 解析单个表达式
+    auto parse_expr() -> ParseResult;
+
+    // 超过 limit 层嵌套时报告 NestingTooDeep 错误
+    auto set_max_nesting(usize limit) -> void {
+        max_nesting_ = limit;
+    }
+
+    // 惰性函数体：只按 `{`/`}` 配对跳过函数体，记为 LazyBlock，
+    // 首次需要时由 expand_function_body 再解析
+    auto set_lazy_bodies(bool lazy) -> void {
+        lazy_bodies_ = lazy;
+    }
+
+    // 使用 decode_literals 得到的字面量池，token 下标须与正在解析的
+    // token 一致。无法解码的字面量（越界、缺少数字、未知转义）报告为
+    // InvalidToken 错误
+    auto set_literals(const LiteralPool* literals) -> void {
+        literals_ = literals;
+    }
+
+    // 在已有 AST 上继续解析，新节点追加在原有节点之后
+    auto adopt_ast(Ast ast) -> void {
+        ast_ = std::move(ast);
+    }
+
+    // 从当前位置解析一个块；lazy 时按 `{`/`}` 配对跳过，生成 LazyBlock
+    auto parse_block(bool lazy = false) -> ParseResult;
+
+    // 从当前位置解析一个块，并把 lazy 节点原地改写为该 Block
+    auto expand_block(NodeIndex lazy) -> ParseResult;
 
     // 创建作用域守卫
     auto scoped_guard() -> ScopedGuard {
@@ -109,6 +334,23 @@ class Parser {
     auto eat_token(TokenKind expected) -> bool;
     auto eat_tokens(usize amount) -> void;
 
+    // 按编译期文法规则检查和消费，见 grammar.hh
+    template <typename Rule>
+    auto peek_rule() const -> bool {
+        return Rule::match(tokens_, cursor_).has_value();
+    }
+
+    template <typename Rule>
+    auto eat_rule() -> bool {
+        auto end = Rule::match(tokens_, cursor_);
+        if (!end) {
+            return false;
+        }
+        cursor_ = *end;
+        release_tokens();
+        return true;
+    }
+
     // Token 获取
     auto next_token() -> Token;
     auto peek_next_token() const -> Token;
@@ -121,9 +363,167 @@ class Parser {
     auto next_token_span() const -> Span;
     auto current_degree() const -> usize;
 
+    // 当前驻留内存的 token 数
+    auto token_window_size() const -> usize {
+        return tokens_.window_size();
+    }
+
   private:
-    // 解析方法（待实现）
+    // 区间运算符 `..` / `..=` 占用的 token 数
+    struct RangeOp {
+        usize length;
+        bool inclusive;
+    };
+
+    // 释放不可能再回溯到的 token
+    auto release_tokens() -> void;
+
+    // 记录从 start 开始的条目或语句的错误，并向前跳到同步点：括号深度
+    // 为 0 的 `;` 之后、`}` 之前（文件作用域中跳过多余的 `}`）或条目关键字
+    // 之前。游标只进不退，且至少前进一个 token。返回 false 表示放弃恢复
+    auto recover(const ParseError& error, usize start, bool in_block) -> bool;
+
+    // 以 next_token_span() 为位置的“期望 what”错误
+    auto expected_error(std::string_view what) const -> ParseError;
+    // 消费一个 token 并生成对应的叶子节点
+    auto add_leaf(NodeKind kind) -> NodeIndex;
+    // 把 scratch_ 中 base 之上的元素写成切片并弹出
+    auto take_slice(usize base) -> NodeIndex;
+    // 从 start 到上一个 token 末尾的跨度
+    auto span_from(u32 start) const -> Span;
+    auto peek_range_op() const -> std::optional<RangeOp>;
+
+    // 解析方法
     auto try_file_scope() -> ParseResult;
+
+    // 条目与语句
+    auto try_item() -> ParseResult;
+    auto try_function_def() -> ParseResult;
+    auto try_param() -> ParseResult;
+    auto try_statement() -> ParseResult;
+    auto try_let_statement() -> ParseResult;
+    auto try_return_statement() -> ParseResult;
+    auto try_if_statement() -> ParseResult;
+    auto try_expr_statement() -> ParseResult;
+    auto try_block() -> ParseResult;
+    auto nesting_error(std::string_view what) const -> ParseError;
+    // 消费 `{` 并压入块帧；失败时返回错误
+    auto open_block(NodeIndex replace) -> std::optional<ParseResult>;
+    // 解析 `if` 与条件，压入 Then 帧并打开 then 块
+    auto open_if() -> std::optional<ParseResult>;
+    // 运行块工作栈，直到栈回到 floor。value 为空表示栈顶的块等待下一条语句
+    auto run_blocks(usize floor, std::optional<ParseResult> value)
+        -> ParseResult;
+    // 按 `{`/`}` 配对跳过一个块，只生成记录跨度的 LazyBlock
+    auto skip_block() -> ParseResult;
+
+    // 表达式：Pratt 解析，一次前向扫描，不经过游标栈回溯，
+    // 在 expr_stack_ 上迭代而不递归
+    auto try_expr(u8 min_power = 0) -> ParseResult;
 };
 
+// 批量解析的上下文，每个工作线程一个。
+//
+// 逐个文件词法分析并解析时复用同一组 token 数组、游标栈和暂存栈，
+// 只重置不重新分配。AST 交给调用方，不能复用，但按上一个文件每个 token
+// 的节点数和子节点槽数预留容量，解析过程中不再逐步扩容
+class ParseContext {
+  private:
+    Parser parser_;
+    TokenBuffer tokens_; // 两次解析之间由上下文持有的 token 数组
+    LiteralPool literals_; // tokens_ 的字面量值，lex 时解码
+    f64 nodes_per_token_    = 0;
+    f64 children_per_token_ = 0;
+    bool lazy_bodies_       = false;
+
+  public:
+    explicit ParseContext(const SourceMap* source_map);
+
+    auto set_lazy_bodies(bool lazy) -> void {
+        lazy_bodies_ = lazy;
+    }
+
+    // 对 text 做词法分析并解码字面量，结果留在上下文中供 parse 使用
+    auto lex(const SourceText& text) -> const TokenBuffer&;
+
+    // 上一次 lex 得到的字面量值
+    auto literals() const -> const LiteralPool& {
+        return literals_;
+    }
+
+    // 解析上一次 lex 得到的 token。成功时返回 AST，否则返回按出现顺序
+    // 收集的全部语法错误
+    auto parse(u32 start_pos) -> std::expected<Ast, std::vector<ParseError>>;
+};
+
+// 文件内并行解析选项
+struct ParallelParseOptions {
+    usize threads          = 0; // 0 表示每个硬件线程一个
+    usize min_chunk_tokens = 16 * 1024; // 每段至少的 token 数
+    bool lazy_bodies       = false;
+};
+
+// 文件内并行解析：在括号深度为 0 的条目关键字（fn、struct、enum、union、
+// mod、use）处切分文件作用域，各段在工作线程上解析为独立的 Ast 片段，
+// 再按顺序合并。合并结果与串行解析逐节点相同；任一段失败时回退到串行
+// 解析，报告的错误也与串行一致
+auto parse_file_parallel(const SourceMap* source_map,
+                         const TokenBuffer& tokens,
+                         u32 start_pos,
+                         const ParallelParseOptions& options = {})
+    -> std::expected<Ast, ParseError>;
+
+// 将 ast 的跨度从 old_tokens 平移到 new_tokens。两者须有相同的
+// fingerprint_tokens，即新文件只改动了空白和注释；start_pos 为解析时
+// 传给 Parser 的起始偏移
+auto remap_ast_spans(Ast& ast,
+                     const TokenBuffer& old_tokens,
+                     const TokenBuffer& new_tokens,
+                     u32 start_pos) -> void;
+
+// 同上，新文件登记在 SourceMap 的另一处：old_start_pos 为原文件的起始偏移，
+// new_start_pos 为新文件的起始偏移
+auto remap_ast_spans(Ast& ast,
+                     const TokenBuffer& old_tokens,
+                     const TokenBuffer& new_tokens,
+                     u32 old_start_pos,
+                     u32 new_start_pos) -> void;
+
+// 展开 function（FunctionDef）的惰性函数体：从 source_map 取回函数体
+// 源码，重新词法分析并解析进同一个 ast，LazyBlock 原地变为 Block，
+// 已有节点的下标不变。返回函数体节点，已展开时直接返回
+auto expand_function_body(Ast& ast,
+                          const SourceMap& source_map,
+                          NodeIndex function) -> ParseResult;
+
+// 一次增量重解析替换掉的节点：旧 AST 的 [old_first, old_last] 换成了
+// 新 AST 的 [new_first, new_last]。之前的节点下标不变，之后的节点下标
+// 整体平移 new_last - old_last，其余分析只需作废这一段
+struct ReplacedNodes {
+    NodeIndex old_first;
+    NodeIndex old_last;
+    NodeIndex new_first;
+    NodeIndex new_last;
+};
+
+// 增量重解析结果
+struct ReparseResult {
+    Ast ast;
+    std::vector<ReplacedNodes> replaced;
+};
+
+// 增量重解析：old_ast 由 old_tokens 解析而来，edit 是 Lexer::relex 对同一
+// 编辑给出的新 token 序列与改动区间。找出把改动的 token 严格包在 `{` 与
+// `}` 之间的最深的块，没有时取包含改动的文件作用域条目，只重新解析这一段
+// token；其余子树原样复用，改动之后的跨度整体平移。结果与从头解析
+// edit.tokens 逐节点相同。找不到这样的单元，或单元在新 token 上不再恰好
+// 解析为一个块或条目时，退回整文件解析，replaced 覆盖全部节点
+auto reparse(const SourceMap* source_map,
+             const Ast& old_ast,
+             const TokenBuffer& old_tokens,
+             const RelexResult& edit,
+             u32 start_pos,
+             bool lazy_bodies = false)
+    -> std::expected<ReparseResult, ParseError>;
+
 #endif
\ No newline at end of file
@@ -4,8 +4,12 @@
 #include <fstream>
 
 SourceFile::SourceFile(String name, String content, u32 start_pos)
-    : name(std::move(name)), content(std::move(content)), start_pos(start_pos) {
+    : name(std::move(name)), content(content), start_pos(start_pos) {
     compute_line_starts();
+    // 加载时校验一次，之后的阶段可以假定文本是合法 UTF-8
+    if (auto offset = find_invalid_utf8(this->content.view())) {
+        invalid_utf8 = static_cast<u32>(*offset);
+    }
 }
 
 auto SourceFile::compute_line_starts() -> void {
@@ -108,14 +112,21 @@ auto SourceMap::add_file(const std::string& name, const std::string& content)
         return it->second;
     }
 
-    u32 file_id = static_cast<u32>(files.size());
-    FileId fid(file_id);
+    return add_file(SourceFile(name, content, next_start_pos));
+}
+
+auto SourceMap::add_file(SourceFile file) -> FileId {
+    auto it = file_id_map.find(file.name);
+    if (it != file_id_map.end()) {
+        return it->second;
+    }
 
-    auto source_file = SourceFile(name, content, next_start_pos);
-    files.push_back(std::move(source_file));
-    file_id_map[name] = fid;
+    FileId fid(static_cast<u32>(files.size()));
+    file.start_pos = next_start_pos;
+    next_start_pos += static_cast<u32>(file.content.size());
 
-    next_start_pos += static_cast<u32>(content.size());
+    file_id_map[file.name] = fid;
+    files.push_back(std::move(file));
 
     return fid;
 }
@@ -159,6 +170,21 @@ auto SourceMap::get_file_id(const std::string& name) const
     return std::nullopt;
 }
 
+auto SourceMap::file_at(u32 global_pos) const -> const SourceFile* {
+    // 起始偏移随登记顺序递增，取最后一个起点不大于 global_pos 的文件
+    auto it = std::upper_bound(
+        files.begin(), files.end(), global_pos,
+        [](u32 pos, const SourceFile& file) { return pos < file.start_pos; });
+    if (it == files.begin()) {
+        return nullptr;
+    }
+    const SourceFile& file = *std::prev(it);
+    if (global_pos > file.start_pos + file.content.size()) {
+        return nullptr;
+    }
+    return &file;
+}
+
 auto SourceMap::lookup_location(u32 global_pos) const
     -> std::optional<Location> {
     // Find which file contains this global position
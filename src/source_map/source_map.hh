@@ -7,6 +7,7 @@
 #include <string_view>
 #include <optional>
 #include "common.hh"
+#include "source_map/utf8.hh"
 
 // 文件 ID，用于唯一标识源文件
 struct FileId {
@@ -74,12 +75,75 @@ struct Span {
     }
 };
 
+// 带哨兵填充的源码文本
+//
+// 文本之后紧跟一个 NUL 哨兵，连同哨兵共有 PADDING 个零字节。
+// 词法分析器依赖这段填充：内层循环遇到哨兵自然停止，无需边界检查，
+// 并且可以按向量宽度整块读取越过逻辑末尾的字节。
+class SourceText {
+  public:
+    static constexpr usize PADDING = 64;
+
+  private:
+    std::vector<char> bytes_; // 文本 + PADDING 个零字节
+    usize size_;
+
+  public:
+    SourceText() : bytes_(PADDING, '\0'), size_(0) {
+    }
+
+    explicit SourceText(std::string_view text) : size_(text.size()) {
+        bytes_.reserve(text.size() + PADDING);
+        bytes_.assign(text.begin(), text.end());
+        bytes_.resize(text.size() + PADDING, '\0');
+    }
+
+    auto view() const -> std::string_view {
+        return std::string_view(bytes_.data(), size_);
+    }
+
+    operator std::string_view() const {
+        return view();
+    }
+
+    auto data() const -> const char* {
+        return bytes_.data();
+    }
+
+    auto size() const -> usize {
+        return size_;
+    }
+
+    auto empty() const -> bool {
+        return size_ == 0;
+    }
+
+    auto operator[](usize index) const -> char {
+        return bytes_[index];
+    }
+
+    auto find(std::string_view str, usize pos = 0) const -> usize {
+        return view().find(str, pos);
+    }
+
+    auto substr(usize pos, usize count = std::string_view::npos) const
+        -> std::string_view {
+        return view().substr(pos, count);
+    }
+
+    friend auto operator==(const SourceText& text, std::string_view str)
+        -> bool {
+        return text.view() == str;
+    }
+};
+
 // 源文件信息
 struct SourceFile {
-    String name;                  // 文件名或路径
-    String content;               // 文件内容
-    u32 start_pos;                // 在全局字节偏移中的起始位置
-    std::vector<u32> line_starts; // 每行在文件中的字节偏移
+    String name;                     // 文件名或路径
+    SourceText content;              // 文件内容（带哨兵填充）
+    u32 start_pos;                   // 在全局字节偏移中的起始位置
+    std::vector<u32> line_starts;    // 每行在文件中的字节偏移
+    std::optional<u32> invalid_utf8; // 第一个非法 UTF-8 字节的偏移
 
     SourceFile(String name, String content, u32 start_pos);
 
@@ -114,6 +178,11 @@ class SourceMap {
     auto add_file(const std::string& name, const std::string& content)
         -> FileId;
 
+    // 添加已构造好的源文件，并为其重新分配全局起始偏移。
+    // 构造 SourceFile（复制文本、行首表、UTF-8 校验）与起始偏移无关，
+    // 可以先在多个线程上完成，再依次登记
+    auto add_file(SourceFile file) -> FileId;
+
     // 从文件系统加载文件
     auto load_file(const std::string& path) -> std::optional<FileId>;
 
@@ -123,6 +192,10 @@ class SourceMap {
     // 根据文件名获取文件ID
     auto get_file_id(const std::string& name) const -> std::optional<FileId>;
 
+    // 查找包含全局字节偏移的源文件（文件末尾的偏移也算在内），
+    // 按起始偏移二分查找
+    auto file_at(u32 global_pos) const -> const SourceFile*;
+
     // 从全局字节偏移获取位置信息
     auto lookup_location(u32 global_pos) const -> std::optional<Location>;
 
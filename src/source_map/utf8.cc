@@ -0,0 +1,217 @@
+#include "source_map/utf8.hh"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BELEG_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Validator = auto (*)(const char* p, const char* end) -> const char*;
+
+// 逐个序列校验，返回第一个非法序列的位置
+auto scalar_validate(const char* p, const char* end) -> const char* {
+    while (p < end) {
+        if (static_cast<u8>(*p) < 0x80) {
+            p++;
+            continue;
+        }
+        Utf8Char c = decode_utf8(p, static_cast<usize>(end - p));
+        if (c.length == 0) {
+            return p;
+        }
+        p += c.length;
+    }
+    return end;
+}
+
+#ifdef BELEG_UTF8_X86
+// SSE2 只能整块跳过 ASCII；含非 ASCII 字节的块逐序列校验。
+// ASCII 块以完整字符结尾，所以下一块总是从字符边界开始。
+auto sse2_validate(const char* p, const char* end) -> const char* {
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (_mm_movemask_epi8(block) == 0) {
+            p += 16;
+            continue;
+        }
+        const char* stop = p + 16;
+        while (p < stop) {
+            Utf8Char c = decode_utf8(p, static_cast<usize>(end - p));
+            if (c.length == 0) {
+                return p;
+            }
+            p += c.length;
+        }
+    }
+    return scalar_validate(p, end);
+}
+
+// Keiser-Lemire 查表算法：用前一字节的高低半字节和当前字节的高半字节
+// 各查一张 16 项表，三者按位与后非零即为非法的两字节组合；
+// 三、四字节序列的长度另由 prev2/prev3 检查。
+// 参见 "Validating UTF-8 In Less Than One Instruction Per Byte" (2021)。
+constexpr u8 TOO_SHORT      = 1 << 0;
+constexpr u8 TOO_LONG       = 1 << 1;
+constexpr u8 OVERLONG_3     = 1 << 2;
+constexpr u8 TOO_LARGE      = 1 << 3;
+constexpr u8 SURROGATE      = 1 << 4;
+constexpr u8 OVERLONG_2     = 1 << 5;
+constexpr u8 TOO_LARGE_1000 = 1 << 6;
+constexpr u8 OVERLONG_4     = 1 << 6;
+constexpr u8 TWO_CONTS      = 1 << 7;
+constexpr u8 CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+[[gnu::target("avx2")]] auto table(u8 a0,  u8 a1,  u8 a2,  u8 a3,
+                                   u8 a4,  u8 a5,  u8 a6,  u8 a7,
+                                   u8 a8,  u8 a9,  u8 a10, u8 a11,
+                                   u8 a12, u8 a13, u8 a14, u8 a15) -> __m256i {
+    return _mm256_setr_epi8(a0, a1, a2, a3, a4, a5, a6, a7,
+                            a8, a9, a10, a11, a12, a13, a14, a15,
+                            a0, a1, a2, a3, a4, a5, a6, a7,
+                            a8, a9, a10, a11, a12, a13, a14, a15);
+}
+
+// 把 prev 的末尾 N 个字节接到 input 前面
+template <int N>
+[[gnu::target("avx2")]] auto shift_in(__m256i input, __m256i prev) -> __m256i {
+    return _mm256_alignr_epi8(input,
+                              _mm256_permute2x128_si256(prev, input, 0x21),
+                              16 - N);
+}
+
+[[gnu::target("avx2")]] auto high_nibble(__m256i v) -> __m256i {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+[[gnu::target("avx2")]] auto block_errors(__m256i input, __m256i prev)
+    -> __m256i {
+    __m256i prev1 = shift_in<1>(input, prev);
+
+    __m256i byte_1_high = _mm256_shuffle_epi8(
+        table(TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+              TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+              TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+              TOO_SHORT | OVERLONG_2,
+              TOO_SHORT,
+              TOO_SHORT | OVERLONG_3 | SURROGATE,
+              TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4),
+        high_nibble(prev1));
+
+    constexpr u8 LARGE = CARRY | TOO_LARGE | TOO_LARGE_1000;
+    __m256i byte_1_low = _mm256_shuffle_epi8(
+        table(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+              CARRY | OVERLONG_2,
+              CARRY, CARRY,
+              CARRY | TOO_LARGE,
+              LARGE, LARGE, LARGE, LARGE, LARGE, LARGE, LARGE, LARGE,
+              LARGE | SURROGATE,
+              LARGE, LARGE),
+        _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+
+    constexpr u8 CONT = TOO_LONG | OVERLONG_2 | TWO_CONTS;
+    __m256i byte_2_high = _mm256_shuffle_epi8(
+        table(TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+              TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+              CONT | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+              CONT | OVERLONG_3 | TOO_LARGE,
+              CONT | SURROGATE | TOO_LARGE,
+              CONT | SURROGATE | TOO_LARGE,
+              TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT),
+        high_nibble(input));
+
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low),
+                                       byte_2_high);
+
+    // 第三、四字节必须是续字节，而且只有这些位置允许两个续字节相连
+    __m256i third  = _mm256_subs_epu8(shift_in<2>(input, prev),
+                                     _mm256_set1_epi8(0xE0u - 0x80));
+    __m256i fourth = _mm256_subs_epu8(shift_in<3>(input, prev),
+                                      _mm256_set1_epi8(0xF0u - 0x80));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                      _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+// 块末尾是否有未完成的多字节序列
+[[gnu::target("avx2")]] auto incomplete(__m256i input) -> __m256i {
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1),
+        static_cast<char>(0xE0 - 1),
+        static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+[[gnu::target("avx2")]] auto avx2_validate(const char* begin, const char* end)
+    -> const char* {
+    __m256i error   = _mm256_setzero_si256();
+    __m256i prev    = _mm256_setzero_si256();
+    __m256i pending = _mm256_setzero_si256();
+
+    auto step = [&](__m256i input) __attribute__((target("avx2"))) {
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, pending);
+        } else {
+            error   = _mm256_or_si256(error, block_errors(input, prev));
+            pending = incomplete(input);
+        }
+        prev = input;
+    };
+
+    const char* p = begin;
+    for (; end - p >= 32; p += 32) {
+        step(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+
+    // 尾部补零；零是 ASCII，也能暴露末尾未完成的序列
+    alignas(32) char tail[32] = {};
+    std::memcpy(tail, p, static_cast<usize>(end - p));
+    step(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+    error = _mm256_or_si256(error, pending);
+
+    if (_mm256_testz_si256(error, error)) {
+        return end;
+    }
+    // 非法输入很少见，由标量实现定位具体位置
+    return scalar_validate(begin, end);
+}
+
+auto cpu_has_sse2() -> bool {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+auto cpu_has_avx2() -> bool {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+auto detect_validator() -> Validator {
+#ifdef BELEG_UTF8_X86
+    if (cpu_has_avx2()) {
+        return avx2_validate;
+    }
+    if (cpu_has_sse2()) {
+        return sse2_validate;
+    }
+#endif
+    return scalar_validate;
+}
+
+} // namespace
+
+auto find_invalid_utf8(std::string_view text) -> std::optional<usize> {
+    static const Validator validate = detect_validator();
+
+    const char* begin = text.data();
+    const char* end   = begin + text.size();
+    const char* error = validate(begin, end);
+    if (error == end) {
+        return std::nullopt;
+    }
+    return static_cast<usize>(error - begin);
+}
@@ -0,0 +1,54 @@
+#ifndef UTF8_HH
+#define UTF8_HH
+
+#include "common.hh"
+#include <optional>
+#include <string_view>
+
+// 解码得到的 Unicode 码点及其 UTF-8 字节数
+struct Utf8Char {
+    u32 code_point;
+    u32 length; // 0 表示非法序列
+};
+
+// 解码 p 处的一个 UTF-8 序列，最多读取 avail 个字节。
+// 拒绝超长编码、代理项和大于 U+10FFFF 的码点。
+constexpr auto decode_utf8(const char* p, usize avail) -> Utf8Char {
+    auto byte = [&](usize i) -> u32 { return static_cast<u8>(p[i]); };
+    auto cont = [&](usize i) -> bool {
+        return i < avail && (byte(i) & 0xC0) == 0x80;
+    };
+
+    if (avail == 0) {
+        return {0, 0};
+    }
+    u32 b0 = byte(0);
+    if (b0 < 0x80) {
+        return {b0, 1};
+    }
+    if (b0 >= 0xC2 && b0 <= 0xDF && cont(1)) {
+        return {(b0 & 0x1F) << 6 | (byte(1) & 0x3F), 2};
+    }
+    if (b0 >= 0xE0 && b0 <= 0xEF && cont(1) && cont(2)) {
+        u32 cp = (b0 & 0x0F) << 12 | (byte(1) & 0x3F) << 6 | (byte(2) & 0x3F);
+        if (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return {0, 0};
+        }
+        return {cp, 3};
+    }
+    if (b0 >= 0xF0 && b0 <= 0xF4 && cont(1) && cont(2) && cont(3)) {
+        u32 cp = (b0 & 0x07) << 18 | (byte(1) & 0x3F) << 12
+                 | (byte(2) & 0x3F) << 6 | (byte(3) & 0x3F);
+        if (cp < 0x10000 || cp > 0x10FFFF) {
+            return {0, 0};
+        }
+        return {cp, 4};
+    }
+    return {0, 0};
+}
+
+// 查找第一个非法 UTF-8 序列的字节偏移，文本合法时返回 std::nullopt。
+// 按 CPU 特性选择 AVX2 / SSE2 / 标量实现，纯 ASCII 块整块跳过。
+auto find_invalid_utf8(std::string_view text) -> std::optional<usize>;
+
+#endif // UTF8_HH
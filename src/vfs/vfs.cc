@@ -235,17 +235,69 @@ auto Vfs::get_ast(VfsNodeId node_id) const -> std::optional<const Ast*> {
     return std::nullopt;
 }
 
-// 设置文件的 AST
-auto Vfs::set_ast(VfsNodeId node_id, std::unique_ptr<Ast> ast) -> bool {
+// 设置文件的 AST 及其 token 指纹
+auto Vfs::set_ast(VfsNodeId node_id,
+                  std::unique_ptr<Ast> ast,
+                  std::optional<TokenFingerprint> fingerprint) -> bool {
     auto node = get_node_mut(node_id);
     if (!node || (*node)->type != VfsNodeType::File) {
         return false;
     }
 
-    (*node)->file.ast = std::move(ast);
+    FileNode& file   = (*node)->file;
+    file.fingerprint = ast ? fingerprint : std::nullopt;
+    file.ast_file_id = ast ? file.source_file_id : std::nullopt;
+    file.ast         = std::move(ast);
     return true;
 }
 
+// 取出文件的 AST
+auto Vfs::take_ast(VfsNodeId node_id) -> std::unique_ptr<Ast> {
+    auto node = get_node_mut(node_id);
+    if (!node || (*node)->type != VfsNodeType::File || !(*node)->file.ast) {
+        return nullptr;
+    }
+
+    FileNode& file = (*node)->file;
+    auto ast       = std::move(*file.ast);
+    file.ast.reset();
+    file.fingerprint.reset();
+    file.ast_file_id.reset();
+    return ast;
+}
+
+// 获取文件的可变 AST
+auto Vfs::get_ast_mut(VfsNodeId node_id) -> std::optional<Ast*> {
+    auto node = get_node_mut(node_id);
+    if (!node || (*node)->type != VfsNodeType::File) {
+        return std::nullopt;
+    }
+
+    if ((*node)->file.ast && *(*node)->file.ast) {
+        return (*node)->file.ast->get();
+    }
+    return std::nullopt;
+}
+
+// 获取文件的 token 指纹
+auto Vfs::get_fingerprint(VfsNodeId node_id) const
+    -> std::optional<TokenFingerprint> {
+    auto node = get_node(node_id);
+    if (!node || (*node)->type != VfsNodeType::File) {
+        return std::nullopt;
+    }
+    return (*node)->file.fingerprint;
+}
+
+// 获取生成文件 AST 时的源文件 ID
+auto Vfs::get_ast_file_id(VfsNodeId node_id) const -> std::optional<FileId> {
+    auto node = get_node(node_id);
+    if (!node || (*node)->type != VfsNodeType::File) {
+        return std::nullopt;
+    }
+    return (*node)->file.ast_file_id;
+}
+
 // 获取目录的入口文件
 auto Vfs::get_entry_file(VfsNodeId dir_node_id) const
     -> std::optional<VfsNodeId> {
@@ -291,6 +343,28 @@ auto Vfs::get_children(VfsNodeId node_id) const
     return (*node)->dir.children;
 }
 
+// 收集所有 Beleg 源文件节点
+auto Vfs::source_files() const -> std::vector<VfsNodeId> {
+    std::vector<VfsNodeId> files;
+    for (VfsNodeId id = 0; id < nodes_.size(); ++id) {
+        const VfsNode& node = nodes_[id];
+        if (node.type != VfsNodeType::File) {
+            continue;
+        }
+        switch (node.file.kind) {
+        case FileKind::Normal:
+        case FileKind::Main:
+        case FileKind::Mod:
+            files.push_back(id);
+            break;
+        case FileKind::PackageConfig:
+        case FileKind::Other:
+            break;
+        }
+    }
+    return files;
+}
+
 // 检查是否为 Beleg 源文件
 auto Vfs::is_beleg_source_file(const std::filesystem::path& path) -> bool {
     auto ext = path.extension().string();
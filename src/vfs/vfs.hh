@@ -4,6 +4,7 @@
 #include "common.hh"
 #include "source_map/source_map.hh"
 #include "ast/ast.hh"
+#include "lex/lex.hh"
 #include <vector>
 #include <optional>
 #include <unordered_map>
@@ -57,20 +58,24 @@ struct FileNode {
     std::optional<FileId> source_file_id;    // 惰性加载的源文件引用
     std::optional<std::unique_ptr<Ast>> ast; // 惰性加载的完整
                                              // AST 树
+    std::optional<TokenFingerprint> fingerprint; // 生成 ast 时的 token 指纹
+    std::optional<FileId> ast_file_id;           // 生成 ast 时的源文件
 
     FileNode(FileKind k) : kind(k) {
     }
 
     // 拷贝构造函数 - 不拷贝 AST（因为 unique_ptr 不能拷贝）
     FileNode(const FileNode& other)
-        : kind(other.kind), source_file_id(other.source_file_id) {
+        : kind(other.kind), source_file_id(other.source_file_id),
+          fingerprint(other.fingerprint), ast_file_id(other.ast_file_id) {
         // 不拷贝 AST，保持为空
     }
 
     // 移动构造函数
     FileNode(FileNode&& other) noexcept
         : kind(other.kind), source_file_id(std::move(other.source_file_id)),
-          ast(std::move(other.ast)) {
+          ast(std::move(other.ast)), fingerprint(other.fingerprint),
+          ast_file_id(other.ast_file_id) {
     }
 
     // 赋值操作符
@@ -78,6 +83,8 @@ struct FileNode {
         if (this != &other) {
             kind           = other.kind;
             source_file_id = other.source_file_id;
+            fingerprint    = other.fingerprint;
+            ast_file_id    = other.ast_file_id;
             // 不拷贝 AST
             ast.reset();
         }
@@ -90,6 +97,8 @@ struct FileNode {
             kind           = std::move(other.kind);
             source_file_id = std::move(other.source_file_id);
             ast            = std::move(other.ast);
+            fingerprint    = other.fingerprint;
+            ast_file_id    = other.ast_file_id;
         }
         return *this;
     }
@@ -240,8 +249,27 @@ class Vfs {
     // 获取文件的 AST
     auto get_ast(VfsNodeId node_id) const -> std::optional<const Ast*>;
 
-    // 设置文件的 AST
-    auto set_ast(VfsNodeId node_id, std::unique_ptr<Ast> ast) -> bool;
+    // 设置文件的 AST 及其 token 指纹，并记下当前的源文件 ID。
+    // 不给出指纹时清除旧指纹，避免新 AST 沿用不相符的指纹
+    auto set_ast(VfsNodeId node_id,
+                 std::unique_ptr<Ast> ast,
+                 std::optional<TokenFingerprint> fingerprint = std::nullopt)
+        -> bool;
+
+    // 取出文件的 AST，连同指纹和生成时的源文件 ID 一起清除
+    auto take_ast(VfsNodeId node_id) -> std::unique_ptr<Ast>;
+
+    // 获取文件的可变 AST，用于原地平移跨度
+    auto get_ast_mut(VfsNodeId node_id) -> std::optional<Ast*>;
+
+    // 获取文件 AST 的 token 指纹。指纹未变的文件只有空白和注释改动，
+    // 可以保留已有 AST
+    auto get_fingerprint(VfsNodeId node_id) const
+        -> std::optional<TokenFingerprint>;
+
+    // 获取生成文件 AST 时的源文件 ID。与 get_source_file_id 不同时，
+    // 源文件已经重新加载，AST 可能已过时
+    auto get_ast_file_id(VfsNodeId node_id) const -> std::optional<FileId>;
 
     // 获取目录的入口文件
     auto get_entry_file(VfsNodeId dir_node_id) const
@@ -251,6 +279,10 @@ class Vfs {
     auto get_children(VfsNodeId node_id) const
         -> std::optional<std::vector<VfsNodeId>>;
 
+    // 收集所有 Beleg 源文件节点（不含 package.toml 等其他文件），
+    // 按节点 ID 升序
+    auto source_files() const -> std::vector<VfsNodeId>;
+
     // 检查是否为 Beleg 源文件
     static auto is_beleg_source_file(const std::filesystem::path& path) -> bool;
 
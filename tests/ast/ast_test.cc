@@ -1,5 +1,33 @@
 #include "ast/ast.hh"
 #include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations while `counting_allocations` is set. The
+// replacements are kept out of line: inlined, GCC sees the malloc and free
+// behind a new/delete pair and warns about the mismatch
+namespace {
+bool counting_allocations = false;
+usize allocation_count    = 0;
+} // namespace
+
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    if (counting_allocations) {
+        ++allocation_count;
+    }
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
 
 class ASTTest : public ::testing::Test {
   protected:
@@ -108,6 +136,12 @@ TEST_F(ASTTest, MultipleChildren) {
     EXPECT_EQ(params_slice->size(), 2u);
     EXPECT_EQ((*params_slice)[0], params[0]);
     EXPECT_EQ((*params_slice)[1], params[1]);
+
+    // A node followed by one with multiple children keeps its own count
+    NodeIndex list = ast.add_node(NodeBuilder(NodeKind::ListOf, Span(0, 30))
+                                      .add_multiple_children(params));
+    EXPECT_EQ(ast.get_children(func_node).size(), 2u);
+    EXPECT_EQ(ast.get_children(list).size(), 1u);
 }
 
 // Test node type classification
@@ -214,5 +248,129 @@ TEST_F(ASTTest, AnotherTestCase) {
     EXPECT_EQ(1, 1); // Placeholder test
 }
 
+// Test that direct node construction allocates nothing once reserved
+TEST_F(ASTTest, AllocationFreeConstruction) {
+    Ast ast;
+    ast.reserve(8, 32);
+
+    counting_allocations = true;
+    allocation_count     = 0;
+    NodeIndex f          = ast.add_node(NodeKind::Id, Span(0, 1));
+    NodeIndex a          = ast.add_node(NodeKind::Id, Span(2, 3));
+    NodeIndex b          = ast.add_node(NodeKind::Int, Span(5, 6));
+    NodeIndex sum        = ast.add_node(NodeKind::Add, Span(2, 6), {a, b});
+    NodeIndex items[]    = {sum, b};
+    NodeIndex args       = ast.add_slice(items);
+    NodeIndex call       = ast.add_node(NodeKind::Call, Span(0, 10), {f, args});
+    counting_allocations = false;
+    EXPECT_EQ(allocation_count, 0u);
+
+    auto sum_children = ast.get_children(sum);
+    ASSERT_EQ(sum_children.size(), 2u);
+    EXPECT_EQ(sum_children[0], a);
+    EXPECT_EQ(sum_children[1], b);
+
+    auto call_children = ast.get_children(call);
+    ASSERT_EQ(call_children.size(), 2u);
+    EXPECT_EQ(call_children[0], f);
+    auto slice = ast.get_multi_child_slice(call_children[1]);
+    ASSERT_TRUE(slice.has_value());
+    ASSERT_EQ(slice->size(), 2u);
+    EXPECT_EQ((*slice)[0], sum);
+    EXPECT_EQ((*slice)[1], b);
+    EXPECT_TRUE(ast.get_children(f).empty());
+}
+
+// Test appending separately built fragments into one Ast
+TEST_F(ASTTest, AppendFragments) {
+    // Two fragments built the way a parser would, then the same nodes
+    // built in one go: appending must reproduce the single layout
+    auto build_call = [](Ast& ast, u32 at) {
+        NodeIndex callee = ast.add_node(NodeKind::Id, Span(at, at + 1));
+        NodeIndex arg    = ast.add_node(NodeKind::Int, Span(at + 2, at + 3));
+        NodeIndex args   = ast.add_slice(std::span(&arg, 1));
+        NodeIndex call
+            = ast.add_node(NodeKind::Call, Span(at, at + 4), {callee, args});
+        return ast.add_node(NodeKind::ReturnStatement,
+                            Span(at, at + 4),
+                            {call});
+    };
+
+    Ast whole;
+    NodeIndex first  = build_call(whole, 0);
+    NodeIndex second = build_call(whole, 10);
+
+    Ast left;
+    Ast right;
+    EXPECT_EQ(build_call(left, 0), first);
+    NodeIndex local = build_call(right, 10);
+    NodeIndex empty = right.add_node(NodeKind::ReturnStatement,
+                                     Span(20, 26),
+                                     {0});
+
+    Ast merged;
+    EXPECT_EQ(merged.append(left), 0u);
+    NodeIndex shift = merged.append(right);
+    EXPECT_EQ(local + shift, second);
+    EXPECT_EQ(merged.get_children(empty + shift)[0], 0u); // none stays 0
+
+    NodeIndex expected_empty = whole.add_node(NodeKind::ReturnStatement,
+                                              Span(20, 26),
+                                              {0});
+    EXPECT_EQ(expected_empty, empty + shift);
+    EXPECT_TRUE(merged == whole);
+
+    EXPECT_TRUE(is_slice_child(NodeType::MultiChildren, 3));
+    EXPECT_TRUE(is_slice_child(NodeType::FunctionDefChildren, 1));
+    EXPECT_FALSE(is_slice_child(NodeType::FunctionDefChildren, 3));
+    EXPECT_FALSE(is_slice_child(NodeType::DoubleChildren, 1));
+}
+
+// Test splicing an edited subtree into an existing Ast
+TEST_F(ASTTest, SpliceSubtree) {
+    // A block of three statements; splicing a new middle statement must
+    // give the layout of building the edited block from scratch
+    auto build_call = [](Ast& ast, u32 at, u32 args) {
+        NodeIndex callee = ast.add_node(NodeKind::Id, Span(at, at + 1));
+        std::vector<NodeIndex> items;
+        for (u32 i = 0; i < args; ++i) {
+            items.push_back(
+                ast.add_node(NodeKind::Int, Span(at + 2 + i, at + 3 + i)));
+        }
+        NodeIndex call = ast.add_node(NodeKind::Call,
+                                      Span(at, at + 4),
+                                      {callee, ast.add_slice(items)});
+        return ast.add_node(NodeKind::ExprStatement, Span(at, at + 4), {call});
+    };
+    auto build_block = [&](Ast& ast, u32 middle_args) {
+        std::vector<NodeIndex> items = {build_call(ast, 0, 1),
+                                        build_call(ast, 10, middle_args),
+                                        build_call(ast, 20, 2)};
+        ast.set_root(ast.add_node(
+            NodeKind::Block, Span(0, 30), {ast.add_slice(items)}));
+        return items;
+    };
+
+    Ast ast;
+    auto items = build_block(ast, 1);
+    auto first = ast.subtree_first(items[1]);
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(*first, items[0] + 1);
+    EXPECT_EQ(ast.subtree_first(ast.root()), 1u);
+
+    Ast fragment;
+    build_call(fragment, 10, 3);
+    NodeIndex root = ast.splice(*first, items[1], fragment);
+
+    Ast expected;
+    auto expected_items = build_block(expected, 3);
+    EXPECT_EQ(root, expected_items[1]);
+    EXPECT_TRUE(ast == expected);
+
+    // Rewritten nodes no longer own a contiguous range
+    ast.replace_node(root, NodeKind::ExprStatement, Span(10, 14), {1});
+    EXPECT_FALSE(ast.subtree_first(root).has_value());
+}
+
 // Main function is provided by gtest_main_dep, so no need
 // to define it
@@ -0,0 +1,294 @@
+#include "corpus.hh"
+
+namespace {
+
+// splitmix64: tiny, fast and identical on every platform
+struct Rng {
+    u64 state;
+
+    auto next() -> u64 {
+        u64 z = (state += 0x9E3779B97F4A7C15);
+        z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z     = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    auto below(u64 bound) -> u64 {
+        return next() % bound;
+    }
+
+    template <typename T, usize N>
+    auto pick(const std::array<T, N>& items) -> const T& {
+        return items[below(N)];
+    }
+};
+
+constexpr std::array<std::string_view, 12> STEMS = {
+    "value", "index",  "count",   "node",   "buffer", "result",
+    "item",  "offset", "context", "parent", "cursor", "scratch",
+};
+
+constexpr std::array<std::string_view, 8> BINARY_OPS = {
+    " + ", " - ", " * ", " / ", " == ", " < ", " and ", " or ",
+};
+
+auto append_ident(String& out, Rng& rng) -> void {
+    out += rng.pick(STEMS);
+    out += '_';
+    out += rng.pick(STEMS);
+    out += std::to_string(rng.below(1000));
+}
+
+auto append_literal(String& out, Rng& rng) -> void {
+    switch (rng.below(5)) {
+    case 0:
+        out += std::to_string(rng.next() >> 20);
+        break;
+    case 1:
+        out += std::to_string(rng.below(100000));
+        out += '.';
+        out += std::to_string(rng.below(1000));
+        if (rng.below(2) == 0) {
+            out += "e-";
+            out += std::to_string(rng.below(30));
+        }
+        break;
+    case 2:
+        out += '"';
+        for (u64 i = 0, n = 4 + rng.below(40); i < n; ++i) {
+            if (rng.below(16) == 0) {
+                out += "\\n";
+            } else {
+                out += static_cast<char>('a' + rng.below(26));
+                if (rng.below(6) == 0) {
+                    out += ' ';
+                }
+            }
+        }
+        out += '"';
+        break;
+    case 3:
+        out += '\'';
+        out += static_cast<char>('a' + rng.below(26));
+        out += '\'';
+        break;
+    default:
+        out += rng.below(2) == 0 ? "true" : "false";
+        break;
+    }
+}
+
+auto append_identifiers_fn(String& out, Rng& rng) -> void {
+    out += "fn ";
+    append_ident(out, rng);
+    out += "(self, ";
+    append_ident(out, rng);
+    out += ": ";
+    append_ident(out, rng);
+    out += ") {\n";
+    for (u64 i = 0, n = 4 + rng.below(12); i < n; ++i) {
+        out += "    let ";
+        append_ident(out, rng);
+        out += " = ";
+        append_ident(out, rng);
+        out += '.';
+        append_ident(out, rng);
+        out += '(';
+        append_ident(out, rng);
+        out += ", ";
+        append_ident(out, rng);
+        out += ")";
+        out += rng.pick(BINARY_OPS);
+        append_ident(out, rng);
+        out += ";\n";
+    }
+    out += "    return ";
+    append_ident(out, rng);
+    out += ";\n}\n\n";
+}
+
+auto append_literals_fn(String& out, Rng& rng) -> void {
+    out += "fn table";
+    out += std::to_string(rng.below(100000));
+    out += "() {\n";
+    for (u64 i = 0, n = 4 + rng.below(8); i < n; ++i) {
+        out += "    let t = [";
+        for (u64 j = 0, m = 4 + rng.below(12); j < m; ++j) {
+            if (j > 0) {
+                out += ", ";
+            }
+            append_literal(out, rng);
+        }
+        out += "];\n";
+    }
+    out += "}\n\n";
+}
+
+auto append_nested_expr(String& out, Rng& rng, u64 depth) -> void {
+    if (depth == 0) {
+        rng.below(2) == 0 ? append_ident(out, rng) : append_literal(out, rng);
+        return;
+    }
+    out += '(';
+    append_nested_expr(out, rng, depth - 1);
+    out += rng.pick(BINARY_OPS);
+    append_ident(out, rng);
+    out += ')';
+}
+
+auto append_nested_fn(String& out, Rng& rng) -> void {
+    u64 depth = 16 + rng.below(48);
+    out += "fn deep";
+    out += std::to_string(rng.below(100000));
+    out += "() {\n";
+    for (u64 d = 0; d < depth; ++d) {
+        out.append(4 * (d + 1), ' ');
+        out += "if ";
+        append_nested_expr(out, rng, 1 + rng.below(8));
+        out += " {\n";
+    }
+    out.append(4 * (depth + 1), ' ');
+    out += "return ";
+    append_nested_expr(out, rng, depth);
+    out += ";\n";
+    for (u64 d = depth; d > 0; --d) {
+        out.append(4 * d, ' ');
+        out += "}\n";
+    }
+    out += "}\n\n";
+}
+
+auto append_long_lines_fn(String& out, Rng& rng) -> void {
+    out += "fn wide";
+    out += std::to_string(rng.below(100000));
+    out += "() {\n";
+    for (u64 i = 0, n = 1 + rng.below(3); i < n; ++i) {
+        out += "    let line = ";
+        usize target = out.size() + 16 * 1024 + rng.below(48 * 1024);
+        append_ident(out, rng);
+        while (out.size() < target) {
+            out += rng.pick(BINARY_OPS);
+            rng.below(3) == 0 ? append_literal(out, rng)
+                              : append_ident(out, rng);
+        }
+        out += ";\n";
+    }
+    out += "}\n\n";
+}
+
+// Operators, calls, indexing, field access, ranges and collections mixed
+// at random, to a bounded depth
+auto append_expr(String& out, Rng& rng, u64 depth) -> void {
+    u64 choice = depth == 0 ? rng.below(2) : rng.below(10);
+    switch (choice) {
+    case 0:
+        append_ident(out, rng);
+        break;
+    case 1:
+        append_literal(out, rng);
+        break;
+    case 2:
+    case 3:
+    case 4:
+        append_expr(out, rng, depth - 1);
+        out += rng.pick(BINARY_OPS);
+        append_expr(out, rng, depth - 1);
+        break;
+    case 5:
+        append_ident(out, rng);
+        out += '(';
+        for (u64 i = 0, n = rng.below(4); i < n; ++i) {
+            if (i > 0) {
+                out += ", ";
+            }
+            append_expr(out, rng, depth - 1);
+        }
+        out += ')';
+        break;
+    case 6:
+        append_ident(out, rng);
+        out += '.';
+        append_ident(out, rng);
+        out += '[';
+        append_expr(out, rng, depth - 1);
+        out += ']';
+        break;
+    case 7:
+        out += '(';
+        append_expr(out, rng, depth - 1);
+        out += ')';
+        break;
+    case 8:
+        // `- ` rather than `-`: two minus signs in a row start a comment
+        out += rng.below(2) == 0 ? "not " : "- ";
+        append_expr(out, rng, depth - 1);
+        break;
+    default:
+        out += '[';
+        append_expr(out, rng, depth - 1);
+        out += "..";
+        append_expr(out, rng, depth - 1);
+        out += ", ";
+        append_expr(out, rng, depth - 1);
+        out += ']';
+        break;
+    }
+}
+
+auto append_expression_statement(String& out, Rng& rng) -> void {
+    append_expr(out, rng, 2 + rng.below(4));
+    out += ";\n";
+}
+
+} // namespace
+
+auto corpus_name(CorpusKind kind) -> std::string_view {
+    switch (kind) {
+    case CorpusKind::Identifiers:
+        return "identifiers";
+    case CorpusKind::Literals:
+        return "literals";
+    case CorpusKind::Nested:
+        return "nested";
+    case CorpusKind::LongLines:
+        return "long_lines";
+    case CorpusKind::Expressions:
+        return "expressions";
+    }
+    return "unknown";
+}
+
+auto parse_corpus_kind(std::string_view name) -> std::optional<CorpusKind> {
+    for (CorpusKind kind : ALL_CORPUS_KINDS) {
+        if (corpus_name(kind) == name) {
+            return kind;
+        }
+    }
+    return std::nullopt;
+}
+
+auto generate_corpus(CorpusKind kind, usize size, u64 seed) -> String {
+    Rng rng{seed ^ (static_cast<u64>(kind) << 56)};
+    String out;
+    out.reserve(size + 64 * 1024);
+    while (out.size() < size) {
+        switch (kind) {
+        case CorpusKind::Identifiers:
+            append_identifiers_fn(out, rng);
+            break;
+        case CorpusKind::Literals:
+            append_literals_fn(out, rng);
+            break;
+        case CorpusKind::Nested:
+            append_nested_fn(out, rng);
+            break;
+        case CorpusKind::LongLines:
+            append_long_lines_fn(out, rng);
+            break;
+        case CorpusKind::Expressions:
+            append_expression_statement(out, rng);
+            break;
+        }
+    }
+    return out;
+}
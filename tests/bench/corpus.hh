@@ -0,0 +1,36 @@
+#ifndef BENCH_CORPUS_HH
+#define BENCH_CORPUS_HH
+
+#include "common.hh"
+#include <array>
+#include <optional>
+#include <string_view>
+
+// Deterministic synthetic Beleg sources for the throughput benchmarks. The
+// same kind, size and seed always produce the same bytes, so results are
+// comparable from one release to the next.
+
+enum class CorpusKind : u8 {
+    Identifiers, // long identifiers, calls and field accesses
+    Literals,    // numbers, strings and chars
+    Nested,      // deeply nested blocks and parenthesized expressions
+    LongLines,   // one statement per line, each line tens of KB wide
+    Expressions, // top-level expression statements the parser accepts
+};
+
+inline constexpr std::array<CorpusKind, 5> ALL_CORPUS_KINDS = {
+    CorpusKind::Identifiers,
+    CorpusKind::Literals,
+    CorpusKind::Nested,
+    CorpusKind::LongLines,
+    CorpusKind::Expressions,
+};
+
+auto corpus_name(CorpusKind kind) -> std::string_view;
+auto parse_corpus_kind(std::string_view name) -> std::optional<CorpusKind>;
+
+/// Generates whole top-level items until the corpus holds at least `size`
+/// bytes; the result is never more than one item over.
+auto generate_corpus(CorpusKind kind, usize size, u64 seed = 1) -> String;
+
+#endif // BENCH_CORPUS_HH
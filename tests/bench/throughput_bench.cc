@@ -0,0 +1,328 @@
+#include "corpus.hh"
+#include "lex/lex.hh"
+#include "lex/literal.hh"
+#include "parse/parse.hh"
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+#include <vector>
+
+// Lexer and parser throughput over synthetic corpora (meson test --benchmark).
+//
+//   throughput_bench [--corpus NAME|all] [--sizes 4K,1M,1G] [--seed N]
+//                    [--output FILE]
+//
+// Every measurement is one JSON object per line on stdout, and appended to
+// FILE when given, so runs can be collected and compared across releases.
+
+namespace {
+
+// Small inputs are repeated until at least this much time has passed
+constexpr f64 MIN_SECONDS = 0.25;
+
+// Size of each file in the parse.batch runs
+constexpr usize BATCH_FILE_BYTES = 4 * 1024;
+
+struct Options {
+    std::vector<CorpusKind> corpora{ALL_CORPUS_KINDS.begin(),
+                                    ALL_CORPUS_KINDS.end()};
+    std::vector<usize> sizes{4 * 1024, 256 * 1024, 16 * 1024 * 1024};
+    u64 seed = 1;
+    String output;
+};
+
+struct Measurement {
+    std::string_view bench;
+    CorpusKind corpus;
+    usize bytes;
+    usize tokens;
+    usize nodes;
+    usize iterations;
+    f64 seconds;
+};
+
+// "64K" -> 65536; suffixes K, M and G are powers of 1024
+auto parse_size(std::string_view text) -> std::optional<usize> {
+    usize value = 0;
+    auto [rest, ec]
+        = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || value == 0) {
+        return std::nullopt;
+    }
+    std::string_view suffix(rest, text.data() + text.size() - rest);
+    if (suffix == "K" || suffix == "k") {
+        value <<= 10;
+    } else if (suffix == "M" || suffix == "m") {
+        value <<= 20;
+    } else if (suffix == "G" || suffix == "g") {
+        value <<= 30;
+    } else if (!suffix.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options> {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return std::nullopt;
+        }
+        std::string_view value = argv[++i];
+
+        if (arg == "--corpus") {
+            if (value == "all") {
+                continue;
+            }
+            auto kind = parse_corpus_kind(value);
+            if (!kind) {
+                std::cerr << "unknown corpus: " << value << std::endl;
+                return std::nullopt;
+            }
+            options.corpora = {*kind};
+        } else if (arg == "--sizes") {
+            options.sizes.clear();
+            std::istringstream list{String(value)};
+            for (String item; std::getline(list, item, ',');) {
+                auto size = parse_size(item);
+                // Token offsets are u32
+                if (!size || *size >= (usize{1} << 32)) {
+                    std::cerr << "bad size: " << item << std::endl;
+                    return std::nullopt;
+                }
+                options.sizes.push_back(*size);
+            }
+        } else if (arg == "--seed") {
+            std::from_chars(value.data(), value.data() + value.size(),
+                            options.seed);
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+auto peak_rss_kb() -> usize {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<usize>(usage.ru_maxrss); // KiB on Linux
+}
+
+// Runs `body` until MIN_SECONDS have passed; `body` returns the tokens and
+// nodes it produced in one iteration
+template <typename F>
+auto measure(std::string_view bench, CorpusKind corpus, usize bytes, F body)
+    -> Measurement {
+    Measurement m{bench, corpus, bytes, 0, 0, 0, 0.0};
+    auto begin = std::chrono::steady_clock::now();
+    do {
+        auto [tokens, nodes] = body();
+        m.tokens             = tokens;
+        m.nodes              = nodes;
+        ++m.iterations;
+        m.seconds = std::chrono::duration<f64>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+    } while (m.seconds < MIN_SECONDS);
+    return m;
+}
+
+auto to_json(const Measurement& m) -> String {
+    f64 per_iter = m.seconds / static_cast<f64>(m.iterations);
+    std::ostringstream out;
+    out << "{\"bench\":\"" << m.bench << "\",\"corpus\":\""
+        << corpus_name(m.corpus) << "\",\"bytes\":" << m.bytes
+        << ",\"tokens\":" << m.tokens << ",\"nodes\":" << m.nodes
+        << ",\"iterations\":" << m.iterations
+        << ",\"seconds_per_iteration\":" << per_iter
+        << ",\"mb_per_s\":" << static_cast<f64>(m.bytes) / per_iter / 1e6
+        << ",\"tokens_per_s\":" << static_cast<f64>(m.tokens) / per_iter
+        << ",\"nodes_per_s\":" << static_cast<f64>(m.nodes) / per_iter
+        << ",\"peak_rss_kb\":" << peak_rss_kb() << "}";
+    return out.str();
+}
+
+auto run_corpus(CorpusKind kind, usize size, u64 seed)
+    -> std::vector<Measurement> {
+    SourceText text(generate_corpus(kind, size, seed));
+    usize bytes = text.size();
+    std::vector<Measurement> results;
+
+    results.push_back(measure("lex.next", kind, bytes, [&] {
+        Lexer lexer(text);
+        usize tokens = 1;
+        while (lexer.next().kind != TokenKind::Eof) {
+            ++tokens;
+        }
+        return std::pair{tokens, usize{0}};
+    }));
+
+    results.push_back(measure("lex.tokenize_all", kind, bytes, [&] {
+        return std::pair{Lexer(text).tokenize_all().size(), usize{0}};
+    }));
+
+    results.push_back(measure("lex.tokenize_parallel", kind, bytes, [&] {
+        return std::pair{Lexer(text).tokenize_parallel().size(), usize{0}};
+    }));
+
+    // One space typed before a line break halfway through the file and
+    // deleted again, on one buffer that moves from edit to edit as an
+    // editor keeps it: relex time per keystroke, which should not grow with
+    // the file
+    usize line_end = text.view().find('\n', bytes / 2);
+    if (line_end != std::string_view::npos) {
+        String spaced(text.view());
+        SourceText typed_text(spaced.insert(line_end, " "));
+        auto where          = static_cast<u32>(line_end);
+        TokenBuffer editing = Lexer(text).tokenize_all();
+        results.push_back(measure("lex.relex", kind, bytes, [&] {
+            auto typed  = Lexer(typed_text).relex(std::move(editing),
+                                                 Span(where, where),
+                                                 " ");
+            auto erased = Lexer(text).relex(std::move(typed.tokens),
+                                            Span(where, where + 1),
+                                            "");
+            editing     = std::move(erased.tokens);
+            return std::pair{editing.size(), usize{0}};
+        }));
+    }
+
+    // The parser is timed on its own: lexing and the token copy it
+    // consumes happen before the clock starts. The copies still take wall
+    // time, so that is bounded too. parse.lazy skips function bodies, as a
+    // signature-only pass would
+    TokenBuffer tokens = Lexer(text).tokenize_all();
+    SourceMap source_map;
+    auto time_parse = [&](std::string_view bench, bool lazy_bodies) {
+        Measurement m{bench, kind, bytes, tokens.size(), 0, 0, 0.0};
+        auto wall_begin = std::chrono::steady_clock::now();
+        auto wall_limit = std::chrono::duration<f64>(4 * MIN_SECONDS);
+        while (m.iterations == 0
+               || (m.seconds < MIN_SECONDS
+                   && std::chrono::steady_clock::now() - wall_begin
+                          < wall_limit)) {
+            DiagCtxt diag_ctx;
+            Parser parser(&source_map, tokens, 0);
+            parser.set_lazy_bodies(lazy_bodies);
+            auto begin = std::chrono::steady_clock::now();
+            parser.parse(diag_ctx);
+            Ast ast = parser.finalize();
+            m.seconds += std::chrono::duration<f64>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+            m.nodes = ast.nodes().size();
+            ++m.iterations;
+        }
+        return m;
+    };
+    results.push_back(time_parse("parse", false));
+    results.push_back(time_parse("parse.lazy", true));
+
+    results.push_back(measure("parse.parallel", kind, bytes, [&] {
+        auto ast = parse_file_parallel(&source_map, tokens, 0);
+        return std::pair{tokens.size(), ast ? ast->nodes().size() : 0};
+    }));
+
+    // One space typed after a `;` halfway through the file: relexing and
+    // reparsing the enclosing block, plus the copies of the old tokens and
+    // Ast that an editor keeps around
+    usize at = text.view().find(';', bytes / 2);
+    Parser old_parser(&source_map, tokens, 0);
+    bool parsed = old_parser.parse_file().has_value();
+    Ast old_ast = old_parser.finalize();
+    if (at != std::string_view::npos && parsed) {
+        ++at;
+        String source(text.view());
+        SourceText edited(source.insert(at, " "));
+        auto where = static_cast<u32>(at);
+        results.push_back(measure("parse.reparse", kind, bytes, [&] {
+            auto edit   = Lexer(edited).relex(tokens, Span(where, where), " ");
+            auto result = reparse(&source_map, old_ast, tokens, edit, 0);
+            return std::pair{edit.tokens.size(),
+                             result ? result->ast.nodes().size() : 0};
+        }));
+    }
+
+    results.push_back(measure("parse.stream", kind, bytes, [&] {
+        DiagCtxt diag_ctx;
+        Parser parser(&source_map, Lexer(text), 0);
+        parser.parse(diag_ctx);
+        return std::pair{tokens.size(), parser.finalize().nodes().size()};
+    }));
+
+    // The same amount of source as many small files, lexed and parsed one
+    // after another: a fresh Lexer output, literal pool and Parser per file,
+    // against one ParseContext that keeps its arrays and presizes each Ast
+    std::vector<SourceText> files;
+    for (usize done = 0; done < bytes; done += files.back().size()) {
+        files.emplace_back(
+            generate_corpus(kind, BATCH_FILE_BYTES, seed + files.size()));
+    }
+    results.push_back(measure("parse.batch", kind, bytes, [&] {
+        usize tokens = 0;
+        usize nodes  = 0;
+        for (const SourceText& file : files) {
+            TokenBuffer buffer   = Lexer(file).tokenize_all();
+            LiteralPool literals = decode_literals(buffer);
+            Parser parser(&source_map, std::move(buffer), 0);
+            parser.set_literals(&literals);
+            tokens += parser.token_window_size();
+            if (parser.parse_file()) {
+                nodes += parser.finalize().nodes().size();
+            }
+        }
+        return std::pair{tokens, nodes};
+    }));
+    ParseContext context(&source_map);
+    results.push_back(measure("parse.batch.context", kind, bytes, [&] {
+        usize tokens = 0;
+        usize nodes  = 0;
+        for (const SourceText& file : files) {
+            tokens += context.lex(file).size();
+            if (auto ast = context.parse(0)) {
+                nodes += ast->nodes().size();
+            }
+        }
+        return std::pair{tokens, nodes};
+    }));
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        return 2;
+    }
+
+    std::ofstream file;
+    if (!options->output.empty()) {
+        file.open(options->output, std::ios::app);
+        if (!file) {
+            std::cerr << "cannot open " << options->output << std::endl;
+            return 1;
+        }
+    }
+
+    for (CorpusKind kind : options->corpora) {
+        for (usize size : options->sizes) {
+            for (const auto& m : run_corpus(kind, size, options->seed)) {
+                String line = to_json(m);
+                std::cout << line << std::endl;
+                if (file) {
+                    file << line << '\n';
+                }
+            }
+        }
+    }
+    return 0;
+}
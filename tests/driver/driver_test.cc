@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include "driver/driver.hh"
+#include "parse/parse.hh"
+#include <filesystem>
+#include <fstream>
 
 class DriverTest : public ::testing::Test {
   protected:
@@ -25,3 +28,198 @@ TEST_F(DriverTest, AnotherTestCase) {
 
 // Main function is provided by gtest_main_dep, so no need
 // to define it
+
+namespace fs = std::filesystem;
+
+class ParseProjectTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / "parse_project_test";
+        fs::remove_all(root);
+        fs::create_directories(root / "src" / "utils" / "deep");
+
+        write(root / "package.toml", "[package]\nname = \"test\"\n");
+        write(root / "src" / "main.bl", "run(1, 2);\n");
+        write(root / "src" / "lib.bl", "a + b * c;\nf(x)[0];\n");
+        write(root / "src" / "utils" / "mod.bl", "-- entry\nnot ready;\n");
+        write(root / "src" / "utils" / "deep" / "more.bl",
+              "[1..10, 3];\nx.y.z;\n");
+        write(root / "README.md", "# not parsed\n");
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    static void write(const fs::path& path, const std::string& content) {
+        std::ofstream(path) << content;
+    }
+
+    auto build() -> Vfs {
+        auto vfs = Vfs::build_from_fs(root.string());
+        EXPECT_TRUE(vfs.has_value());
+        return std::move(*vfs);
+    }
+
+    fs::path root;
+};
+
+TEST_F(ParseProjectTest, ParsesEverySourceFile) {
+    Vfs vfs = build();
+    SourceMap source_map;
+    DiagCtxt diag_ctx;
+
+    auto report = parse_project(vfs, source_map, diag_ctx, {.threads = 4});
+    EXPECT_EQ(report.files, 4u);
+    EXPECT_EQ(report.parsed, 4u);
+    EXPECT_TRUE(report.unreadable.empty());
+    EXPECT_TRUE(report.failed.empty());
+    EXPECT_EQ(diag_ctx.error_count(), 0u);
+    EXPECT_EQ(source_map.get_files().size(), 4u);
+
+    for (VfsNodeId node : vfs.source_files()) {
+        auto file_id = vfs.get_source_file_id(node);
+        ASSERT_TRUE(file_id.has_value());
+        const SourceFile* file = source_map.get_file(*file_id);
+        ASSERT_NE(file, nullptr);
+        EXPECT_GE(report.bytes, file->content.size());
+
+        auto ast = vfs.get_ast(node);
+        ASSERT_TRUE(ast.has_value() && *ast != nullptr);
+        EXPECT_EQ((*ast)->get_node_kind((*ast)->root()), NodeKind::FileScope);
+        // 跨度落在该文件的全局偏移范围内
+        for (Span span : (*ast)->spans().subspan(1)) {
+            EXPECT_GE(span.start, file->start_pos);
+            EXPECT_LE(span.end, file->start_pos + file->content.size());
+        }
+
+        auto fingerprint = vfs.get_fingerprint(node);
+        ASSERT_TRUE(fingerprint.has_value());
+        EXPECT_EQ(*fingerprint,
+                  fingerprint_tokens(Lexer(file->content).tokenize_all()));
+    }
+
+    auto readme = vfs.resolve("README.md");
+    ASSERT_TRUE(readme.has_value());
+    EXPECT_FALSE(vfs.get_source_file_id(*readme).has_value());
+}
+
+TEST_F(ParseProjectTest, IndependentOfThreadCount) {
+    Vfs serial_vfs = build();
+    SourceMap serial_map;
+    DiagCtxt serial_diag;
+    parse_project(serial_vfs, serial_map, serial_diag, {.threads = 1});
+
+    Vfs parallel_vfs = build();
+    SourceMap parallel_map;
+    DiagCtxt parallel_diag;
+    parse_project(parallel_vfs, parallel_map, parallel_diag, {.threads = 8});
+
+    auto files = serial_vfs.source_files();
+    ASSERT_EQ(files, parallel_vfs.source_files());
+    for (VfsNodeId node : files) {
+        auto serial   = serial_vfs.get_ast(node);
+        auto parallel = parallel_vfs.get_ast(node);
+        ASSERT_TRUE(serial && parallel);
+        EXPECT_TRUE(std::ranges::equal((*serial)->nodes(),
+                                       (*parallel)->nodes()));
+        EXPECT_TRUE(std::ranges::equal((*serial)->spans(),
+                                       (*parallel)->spans()));
+    }
+}
+
+TEST_F(ParseProjectTest, ReportsErrorsAndKeepsGoing) {
+    write(root / "src" / "lib.bl", "a + ;\nfn f() { let = 1; g(); }\nb;\n");
+    Vfs vfs = build();
+    SourceMap source_map;
+    DiagCtxt diag_ctx;
+
+    auto report = parse_project(vfs, source_map, diag_ctx);
+    EXPECT_EQ(report.files, 4u);
+    EXPECT_EQ(report.parsed, 3u);
+    ASSERT_EQ(report.failed.size(), 1u);
+    EXPECT_EQ(report.failed[0], *vfs.resolve("src/lib.bl"));
+    EXPECT_EQ(diag_ctx.error_count(), 2u); // 一遍报告文件中的每个错误
+    EXPECT_FALSE(vfs.get_ast(report.failed[0]).value_or(nullptr));
+    EXPECT_TRUE(vfs.get_ast(*vfs.resolve("src/main.bl")).value_or(nullptr));
+}
+
+TEST_F(ParseProjectTest, ReusesLoadedSources) {
+    Vfs vfs = build();
+    SourceMap source_map;
+    DiagCtxt diag_ctx;
+
+    auto main_id = vfs.resolve("src/main.bl");
+    ASSERT_TRUE(main_id.has_value());
+    FileId preloaded = source_map.add_file("main", "done;\n");
+    vfs.set_source_file_id(*main_id, preloaded);
+
+    auto report = parse_project(vfs, source_map, diag_ctx);
+    EXPECT_EQ(report.parsed, 4u);
+    EXPECT_EQ(vfs.get_source_file_id(*main_id), preloaded);
+    EXPECT_EQ(source_map.get_files().size(), 4u);
+}
+
+TEST_F(ParseProjectTest, ReusesUnchangedAsts) {
+    Vfs vfs = build();
+    SourceMap source_map;
+    DiagCtxt diag_ctx;
+    parse_project(vfs, source_map, diag_ctx);
+
+    // AST 由当前源文件生成的文件不再处理
+    auto main_id        = *vfs.resolve("src/main.bl");
+    auto lib_id         = *vfs.resolve("src/lib.bl");
+    const Ast* main_ast = *vfs.get_ast(main_id);
+    auto report         = parse_project(vfs, source_map, diag_ctx);
+    EXPECT_EQ(report.reused, 4u);
+    EXPECT_EQ(report.parsed, 0u);
+    EXPECT_EQ(report.bytes, 0u);
+
+    // main.bl 只改动空白和注释，沿用原 AST；lib.bl 改动了 token，重新解析
+    FileId edited  = source_map.add_file("main", "-- edited\nrun( 1,\n2 ) ;\n");
+    FileId changed = source_map.add_file("lib", "a + b;\n");
+    vfs.set_source_file_id(main_id, edited);
+    vfs.set_source_file_id(lib_id, changed);
+
+    report = parse_project(vfs, source_map, diag_ctx);
+    EXPECT_EQ(report.reused, 3u);
+    EXPECT_EQ(report.parsed, 1u);
+    EXPECT_EQ(*vfs.get_ast(main_id), main_ast);
+    EXPECT_EQ(vfs.get_ast_file_id(main_id), edited);
+    EXPECT_EQ(vfs.get_ast_file_id(lib_id), changed);
+
+    // 平移后的跨度与重新解析新文件的结果相同
+    const SourceFile* file = source_map.get_file(edited);
+    Parser parser(&source_map,
+                  Lexer(file->content).tokenize_all(),
+                  file->start_pos);
+    ASSERT_TRUE(parser.parse_file().has_value());
+    EXPECT_TRUE(std::ranges::equal(main_ast->spans(),
+                                   parser.finalize().spans()));
+}
+
+TEST_F(ParseProjectTest, LazyFunctionBodies) {
+    write(root / "src" / "lib.bl", "fn f(x: int) { let y = x; g(y); }\n");
+    Vfs vfs = build();
+    SourceMap source_map;
+    DiagCtxt diag_ctx;
+
+    auto report = parse_project(vfs, source_map, diag_ctx,
+                                {.threads = 2, .lazy_bodies = true});
+    EXPECT_EQ(report.parsed, 4u);
+
+    auto lib = vfs.resolve("src/lib.bl");
+    ASSERT_TRUE(lib.has_value());
+    Ast* ast = vfs.get_ast_mut(*lib).value_or(nullptr);
+    ASSERT_NE(ast, nullptr);
+    NodeIndex function
+        = (*ast->get_multi_child_slice(ast->get_children(ast->root())[0]))[0];
+    NodeIndex body = ast->get_children(function)[3];
+    EXPECT_EQ(ast->get_node_kind(body), NodeKind::LazyBlock);
+
+    auto expanded = expand_function_body(*ast, source_map, function);
+    ASSERT_TRUE(expanded.has_value());
+    EXPECT_EQ(ast->get_node_kind(body), NodeKind::Block);
+    EXPECT_EQ(ast->get_multi_child_slice(ast->get_children(body)[0])->size(),
+              2u);
+}
@@ -0,0 +1,147 @@
+#include "lex/lex.hh"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Keyword lookup microbenchmark: the perfect-hash Lexer::is_keyword against
+// the linear comparison chain it replaced, over identifier-heavy input.
+
+namespace {
+
+auto linear_is_keyword(std::string_view ident) -> std::optional<TokenKind> {
+#define KEYWORD(keyword, kind)                                                 \
+    if (ident == #keyword)                                                     \
+        return TokenKind::kind;
+
+    KEYWORD(and, And)
+    KEYWORD(as, As)
+    KEYWORD(bool, Bool)
+    KEYWORD(break, Break)
+    KEYWORD(catch, Catch)
+    KEYWORD(const, Const)
+    KEYWORD(continue, Continue)
+    KEYWORD(else, Else)
+    KEYWORD(enum, Enum)
+    KEYWORD(error, Error)
+    KEYWORD(extern, Extern)
+    KEYWORD(false, False)
+    KEYWORD(fn, Fn)
+    KEYWORD(for, For)
+    KEYWORD(if, If)
+    KEYWORD(in, In)
+    KEYWORD(inline, Inline)
+    KEYWORD(is, Is)
+    KEYWORD(let, Let)
+    KEYWORD(match, Match)
+    KEYWORD(mod, Mod)
+    KEYWORD(newtype, Newtype)
+    KEYWORD(not, Not)
+    KEYWORD(null, Null)
+    KEYWORD(or, Or)
+    KEYWORD(private, Private)
+    KEYWORD(ref, Ref)
+    KEYWORD(return, Return)
+    KEYWORD(self, SelfLower)
+    KEYWORD(Self, SelfCap)
+    KEYWORD(static, Static)
+    KEYWORD(struct, Struct)
+    KEYWORD(test, Test)
+    KEYWORD(true, True)
+    KEYWORD(typealias, Typealias)
+    KEYWORD(union, Union)
+    KEYWORD(use, Use)
+    KEYWORD(when, When)
+    KEYWORD(while, While)
+
+#undef KEYWORD
+    return std::nullopt;
+}
+
+// Deterministic mix of keywords and identifiers, roughly one keyword in four
+auto make_words(usize count) -> std::vector<std::string> {
+    const char* keywords[] = {"fn",     "let",   "return", "if",   "else",
+                              "while",  "struct", "self",  "true", "match"};
+    const char* stems[]    = {"value", "index", "count",  "node", "buffer",
+                              "x",     "lhs",   "result", "item", "w"};
+
+    std::vector<std::string> words;
+    words.reserve(count);
+    u32 state = 12345;
+    for (usize i = 0; i < count; ++i) {
+        state = state * 1664525u + 1013904223u;
+        if ((state >> 28) < 4) {
+            words.emplace_back(keywords[(state >> 8) % 10]);
+        } else {
+            words.emplace_back(stems[(state >> 8) % 10]);
+            words.back() += std::to_string((state >> 16) % 100);
+        }
+    }
+    return words;
+}
+
+template <typename F>
+auto time_lookups(const std::vector<std::string>& words, int rounds, F lookup)
+    -> std::pair<f64, usize> {
+    usize hits = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto& word : words) {
+            hits += lookup(word).has_value();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    f64 ns   = std::chrono::duration<f64, std::nano>(end - begin).count();
+    return {ns / (static_cast<f64>(words.size()) * rounds), hits};
+}
+
+} // namespace
+
+int main() {
+    constexpr usize WORDS = 200000;
+    constexpr int ROUNDS  = 20;
+    auto words            = make_words(WORDS);
+
+    Lexer lexer("");
+    auto [before, before_hits]
+        = time_lookups(words, ROUNDS, linear_is_keyword);
+    auto [after, after_hits]
+        = time_lookups(words, ROUNDS, [&](const std::string& word) {
+              return lexer.is_keyword(word);
+          });
+
+    if (before_hits != after_hits) {
+        std::cerr << "keyword lookup mismatch: " << before_hits
+                  << " != " << after_hits << std::endl;
+        return 1;
+    }
+
+    String source;
+    for (const auto& word : words) {
+        source += word;
+        source += ' ';
+    }
+
+    usize tokens = 0;
+    auto begin   = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        Lexer source_lexer(source);
+        while (source_lexer.next().kind != TokenKind::Eof) {
+            tokens++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    f64 secs = std::chrono::duration<f64>(end - begin).count();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "is_keyword (linear chain): " << before << " ns/ident"
+              << std::endl;
+    std::cout << "is_keyword (perfect hash): " << after << " ns/ident"
+              << std::endl;
+    std::cout << "speedup:                   " << before / after << "x"
+              << std::endl;
+    std::cout << "lexing identifier-heavy input: "
+              << static_cast<f64>(tokens) / secs / 1e6 << " Mtokens/s"
+              << std::endl;
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "lex/lex.hh"
+#include "lex/literal.hh"
 
 class LexTest : public ::testing::Test {
   protected:
@@ -103,6 +104,14 @@ TEST_F(LexTest, LexerNumbers) {
     EXPECT_EQ(token.kind, TokenKind::Int);
     EXPECT_EQ(token.start, 0u);
     EXPECT_EQ(token.end, 3u);
+
+    // `1.` only lexes as a real when a digit follows, so ranges stay apart
+    TokenBuffer range = Lexer("1..5").tokenize_all();
+    ASSERT_EQ(range.size(), 5u);
+    EXPECT_EQ(range.kind(0), TokenKind::Int);
+    EXPECT_EQ(range.kind(1), TokenKind::Dot);
+    EXPECT_EQ(range.kind(2), TokenKind::Dot);
+    EXPECT_EQ(range.kind(3), TokenKind::Int);
 }
 
 // Test Lexer with string literals
@@ -124,3 +133,542 @@ TEST_F(LexTest, LexerEOF) {
     Token token = lexer.next();
     EXPECT_EQ(token.kind, TokenKind::Eof);
 }
+
+// Every SIMD kernel set must stop at exactly the same byte as the scalar one
+TEST_F(LexTest, ScanKernelsMatchScalar) {
+    std::string input;
+    for (int i = 0; i < 300; ++i) {
+        input += std::string(i % 41, i % 3 == 0 ? ' ' : '\t');
+        input += std::string(i % 37, static_cast<char>('a' + i % 26));
+        input += std::string(i % 35, static_cast<char>('0' + i % 10));
+        input += "_Z9\n\r\v\f";
+        input += static_cast<char>(0x80 + i % 0x80);
+    }
+
+    auto kernels   = supported_scan_kernels();
+    const auto& sc = kernels.front();
+    ASSERT_STREQ(sc.name, "scalar");
+
+    const char* begin = input.data();
+    const char* end   = begin + input.size();
+    for (const auto& k : kernels) {
+        for (const char* p = begin; p < end; ++p) {
+            ASSERT_EQ(k.whitespace(p, end), sc.whitespace(p, end)) << k.name;
+            ASSERT_EQ(k.ident_tail(p, end), sc.ident_tail(p, end)) << k.name;
+            ASSERT_EQ(k.digits(p, end), sc.digits(p, end)) << k.name;
+        }
+    }
+}
+
+// Padded kernels stop at the sentinel without an end pointer
+TEST_F(LexTest, PaddedScanKernels) {
+    std::string input;
+    for (int i = 0; i < 100; ++i) {
+        input += std::string(i % 41, ' ');
+        input += std::string(i % 37, static_cast<char>('a' + i % 26));
+        input += std::string(i % 35, static_cast<char>('0' + i % 10));
+    }
+    SourceText text(input);
+
+    const char* begin = text.data();
+    const char* end   = begin + text.size();
+    const auto& sc    = supported_scan_kernels().front();
+    for (const auto& k : supported_scan_kernels()) {
+        for (const char* p = begin; p <= end; ++p) {
+            ASSERT_EQ(k.padded_whitespace(p), sc.whitespace(p, end)) << k.name;
+            ASSERT_EQ(k.padded_ident_tail(p), sc.ident_tail(p, end)) << k.name;
+            ASSERT_EQ(k.padded_digits(p), sc.digits(p, end)) << k.name;
+        }
+    }
+}
+
+// Test long whitespace runs and identifiers crossing vector boundaries
+TEST_F(LexTest, LexerLongRuns) {
+    std::string ident(70, 'x');
+    ident += "_9";
+    std::string source = std::string(100, ' ') + ident + "\n\t\t"
+                         + std::string(40, '7') + ".5" + std::string(33, ' ');
+    Lexer lexer(source);
+
+    Token token1 = lexer.next();
+    EXPECT_EQ(token1.kind, TokenKind::Id);
+    EXPECT_EQ(token1.start, 100u);
+    EXPECT_EQ(token1.end, 172u);
+
+    Token token2 = lexer.next();
+    EXPECT_EQ(token2.kind, TokenKind::Real);
+    EXPECT_EQ(token2.start, 175u);
+    EXPECT_EQ(token2.end, 217u);
+
+    EXPECT_EQ(lexer.next().kind, TokenKind::Eof);
+}
+
+// Test the keyword perfect hash against every keyword and some near misses
+TEST_F(LexTest, KeywordLookup) {
+    Lexer lexer("");
+    for (auto kind = static_cast<int>(TokenKind::And);
+         kind <= static_cast<int>(TokenKind::While);
+         ++kind) {
+        auto keyword = static_cast<TokenKind>(kind);
+        EXPECT_EQ(lexer.is_keyword(lexeme(keyword)), keyword)
+            << lexeme(keyword);
+    }
+
+    for (std::string_view word :
+         {"", "a", "fnn", "Fn", "whilee", "typealia", "selF", "nul", "x"}) {
+        EXPECT_FALSE(lexer.is_keyword(word).has_value()) << word;
+    }
+}
+
+// Test that every operator spelling lexes to its own kind
+TEST_F(LexTest, LexerOperators) {
+    std::vector<TokenKind> kinds;
+    for (auto kind = static_cast<int>(TokenKind::Plus);
+         kind <= static_cast<int>(TokenKind::At);
+         ++kind) {
+        if (static_cast<TokenKind>(kind) != TokenKind::Quote) {
+            kinds.push_back(static_cast<TokenKind>(kind));
+        }
+    }
+
+    std::string source;
+    for (auto kind : kinds) {
+        source += lexeme(kind);
+        source += ' ';
+    }
+
+    Lexer lexer(source);
+    for (auto kind : kinds) {
+        Token token = lexer.next();
+        EXPECT_EQ(token.kind, kind) << lexeme(kind);
+        EXPECT_EQ(token.end - token.start, lexeme(kind).size());
+    }
+    EXPECT_EQ(lexer.next().kind, TokenKind::Eof);
+
+    // Longest match, and no match across whitespace
+    Lexer pairs("=== -> - > +++");
+    std::vector<TokenKind> expected = {TokenKind::EqEq,
+                                       TokenKind::Eq,
+                                       TokenKind::Arrow,
+                                       TokenKind::Minus,
+                                       TokenKind::Gt,
+                                       TokenKind::PlusPlus,
+                                       TokenKind::Plus,
+                                       TokenKind::Eof};
+    for (auto kind : expected) {
+        EXPECT_EQ(pairs.next().kind, kind);
+    }
+}
+
+// Test that unknown bytes are consumed one at a time
+TEST_F(LexTest, LexerInvalidBytesAdvance) {
+    std::string_view source = "a \x01`\xff b";
+    Lexer lexer(source);
+
+    EXPECT_EQ(lexer.next().kind, TokenKind::Id);
+    for (u32 offset = 2; offset < 5; ++offset) {
+        Token token = lexer.next();
+        EXPECT_EQ(token.kind, TokenKind::Invalid);
+        EXPECT_EQ(token.start, offset);
+        EXPECT_EQ(token.end, offset + 1);
+    }
+    EXPECT_EQ(lexer.next().kind, TokenKind::Id);
+    EXPECT_EQ(lexer.next().kind, TokenKind::Eof);
+}
+
+// Test bulk tokenization into a TokenBuffer
+TEST_F(LexTest, TokenizeAll) {
+    std::string_view source = "fn main() { let x = 0x2A + y; }";
+
+    Lexer stepper(source);
+    std::vector<Token> expected;
+    do {
+        expected.push_back(stepper.next());
+    } while (expected.back().kind != TokenKind::Eof);
+
+    Lexer lexer(source);
+    TokenBuffer tokens = lexer.tokenize_all();
+    ASSERT_EQ(tokens.size(), expected.size());
+    EXPECT_GE(tokens.capacity(),
+              source.size() / Lexer::BYTES_PER_TOKEN_ESTIMATE);
+    for (usize i = 0; i < tokens.size(); ++i) {
+        EXPECT_EQ(tokens.kind(i), expected[i].kind);
+        EXPECT_EQ(tokens.start(i), expected[i].start);
+        EXPECT_EQ(tokens.end(i), expected[i].end);
+    }
+
+    TokenBuffer empty = Lexer("").tokenize_all();
+    ASSERT_EQ(empty.size(), 1u);
+    EXPECT_EQ(empty.kind(0), TokenKind::Eof);
+
+    // tokenize_into replaces the contents and keeps the arrays
+    usize capacity = tokens.capacity();
+    Lexer("x;").tokenize_into(tokens);
+    ASSERT_EQ(tokens.size(), 3u);
+    EXPECT_EQ(tokens.kind(0), TokenKind::Id);
+    EXPECT_EQ(tokens.end(0), 1u);
+    EXPECT_EQ(tokens.capacity(), capacity);
+}
+
+// Test that compact storage recomputes the same token ends
+TEST_F(LexTest, CompactTokenStorage) {
+    std::string_view source
+        = R"(fn f(x: i32) -> i32 { return x +  0b101 * 1.5e3; } "a\"b" 'c' ` _y)";
+
+    TokenBuffer full    = Lexer(source).tokenize_all();
+    TokenBuffer compact = Lexer(source).tokenize_all(TokenStorage::Compact);
+    EXPECT_EQ(compact.storage(), TokenStorage::Compact);
+
+    ASSERT_EQ(compact.size(), full.size());
+    for (usize i = 0; i < full.size(); ++i) {
+        EXPECT_EQ(compact.kind(i), full.kind(i));
+        EXPECT_EQ(compact.start(i), full.start(i));
+        EXPECT_EQ(compact.end(i), full.end(i)) << lexeme(full.kind(i));
+    }
+
+    // 5 bytes per token instead of 9
+    EXPECT_EQ(compact.memory_usage(), compact.capacity() * 5);
+    EXPECT_EQ(full.memory_usage(), full.capacity() * 9);
+}
+
+// Test that chunked parallel lexing matches serial lexing, including chunks
+// that start inside string and character literals or comments
+TEST_F(LexTest, TokenizeParallel) {
+    std::string source;
+    for (int i = 0; i < 200; ++i) {
+        if (i % 50 == 0) {
+            source += "{- " + std::string(3000, '\n') + " -}\n";
+        }
+        source += "fn f" + std::to_string(i) + "(x: i32) -> i32 {\n";
+        source += "    let s = \"line one\nfn not_code() { 'x' }\n\";\n";
+        source += "    let c = '\\\n';\n";
+        source += "    return x + 0x1F * 2.5e-3; -- \" unbalanced\n}\n";
+    }
+
+    TokenBuffer serial = Lexer(source).tokenize_all();
+    for (TokenStorage storage : {TokenStorage::Full, TokenStorage::Compact}) {
+        for (usize chunk_size : {1, 7, 64, 1000}) {
+            TokenBuffer parallel = Lexer(source).tokenize_parallel(
+                {.threads = 4, .min_chunk_size = chunk_size, .storage = storage});
+
+            ASSERT_EQ(parallel.size(), serial.size()) << chunk_size;
+            for (usize i = 0; i < serial.size(); ++i) {
+                ASSERT_EQ(parallel.kind(i), serial.kind(i)) << i;
+                ASSERT_EQ(parallel.start(i), serial.start(i)) << i;
+                ASSERT_EQ(parallel.end(i), serial.end(i)) << i;
+            }
+        }
+    }
+
+    TokenBuffer empty = Lexer("").tokenize_parallel({.threads = 4});
+    ASSERT_EQ(empty.size(), 1u);
+    EXPECT_EQ(empty.kind(0), TokenKind::Eof);
+}
+
+// Test that relexing an edit matches lexing the edited source from scratch
+TEST_F(LexTest, RelexEdit) {
+    std::string before = "fn f(x: i32) -> i32 {\n"
+                         "    let s = \"abc\";\n"
+                         "    return x + 42;\n"
+                         "}\n"
+                         "fn g() { h(1.5, 'c') }\n";
+
+    struct Edit {
+        u32 start;
+        u32 end;
+        std::string_view inserted;
+    };
+    auto end = static_cast<u32>(before.size());
+    std::vector<Edit> edits = {
+        {0, 0, "  "},        // insert at the start
+        {3, 4, "ff"},        // grow an identifier
+        {20, 20, "="},       // new operator before `{`
+        {35, 35, "\""},      // open a string that swallows the rest
+        {38, 39, ""},        // drop a closing quote
+        {56, 58, "4_2"},     // split a literal
+        {13, 15, "=>"},      // `->` becomes `=>`
+        {61, 61, "\n\n"},    // whitespace only
+        {end, end, "fn k"},  // append at the end
+    };
+
+    for (TokenStorage storage : {TokenStorage::Full, TokenStorage::Compact}) {
+        for (const auto& edit : edits) {
+            std::string after = before;
+            after.replace(edit.start, edit.end - edit.start, edit.inserted);
+
+            TokenBuffer old      = Lexer(before).tokenize_all(storage);
+            TokenBuffer expected = Lexer(after).tokenize_all(storage);
+            usize old_size       = old.size();
+
+            RelexResult result = Lexer(after).relex(
+                std::move(old), Span(edit.start, edit.end), edit.inserted);
+            const TokenBuffer& tokens = result.tokens;
+
+            ASSERT_EQ(tokens.size(), expected.size()) << edit.inserted;
+            for (usize i = 0; i < expected.size(); ++i) {
+                ASSERT_EQ(tokens.kind(i), expected.kind(i)) << i;
+                ASSERT_EQ(tokens.start(i), expected.start(i)) << i;
+                ASSERT_EQ(tokens.end(i), expected.end(i)) << i;
+            }
+            EXPECT_LE(result.first, result.old_last);
+            EXPECT_LE(result.first, result.new_last);
+            EXPECT_EQ(result.new_last - result.old_last,
+                      tokens.size() - old_size);
+        }
+    }
+
+    // An identifier decodes the whole UTF-8 character after it, so a token
+    // ending a few bytes before the edit can still change: `x×` -> `xé`
+    RelexResult widened = Lexer("x\xC3\xA9;\n")
+                              .relex(Lexer("x\xC3\x97;\n").tokenize_all(),
+                                     Span(2, 3),
+                                     "\xA9");
+    EXPECT_EQ(widened.first, 0u);
+    EXPECT_EQ(widened.tokens.kind(0), TokenKind::Id);
+    EXPECT_EQ(widened.tokens.end(0), 3u);
+    EXPECT_EQ(widened.tokens.kind(1), TokenKind::Semi);
+
+    // A one-byte change in the middle relexes only the tokens next to it:
+    // the literal it touches and the `+` whose lookahead reaches it
+    std::string after = before;
+    after[57]         = '7';
+    RelexResult result
+        = Lexer(after).relex(Lexer(before).tokenize_all(), Span(57, 58), "7");
+    EXPECT_EQ(result.new_last - result.first, 2u);
+    EXPECT_EQ(result.old_last - result.first, 2u);
+    EXPECT_EQ(result.tokens.kind(result.first), TokenKind::Plus);
+    EXPECT_EQ(result.tokens.kind(result.first + 1), TokenKind::Int);
+
+    // Chained edits reuse the buffer of the previous one, whose tokens past
+    // the last edit still carry a pending shift: type and delete back and
+    // forth across the file, with runs that outgrow the gap
+    std::string chained;
+    for (int i = 0; i < 40; ++i) {
+        chained += before;
+    }
+    for (TokenStorage storage : {TokenStorage::Full, TokenStorage::Compact}) {
+        std::string text   = chained;
+        TokenBuffer tokens = Lexer(text).tokenize_all(storage);
+        for (u32 step = 0; step < 60; ++step) {
+            auto at = static_cast<u32>((step * 7919) % text.size());
+            std::string inserted
+                = step % 3 == 0 ? std::string(step * 3, 'x') : "y";
+            u32 removed = step % 2 == 0 ? 0 : std::min<u32>(step, 5);
+            removed     = std::min<u32>(removed, text.size() - at);
+
+            text.replace(at, removed, inserted);
+            tokens = Lexer(text)
+                         .relex(std::move(tokens),
+                                Span(at, at + removed),
+                                inserted)
+                         .tokens;
+
+            TokenBuffer expected = Lexer(text).tokenize_all(storage);
+            ASSERT_EQ(tokens.size(), expected.size()) << step;
+            for (usize i = 0; i < expected.size(); ++i) {
+                ASSERT_EQ(tokens.kind(i), expected.kind(i)) << step;
+                ASSERT_EQ(tokens.start(i), expected.start(i)) << step;
+                ASSERT_EQ(tokens.end(i), expected.end(i)) << step;
+            }
+        }
+        // Closing the gap keeps the tokens
+        TokenBuffer expected = Lexer(text).tokenize_all(storage);
+        auto starts          = tokens.starts();
+        ASSERT_EQ(starts.size(), expected.size());
+        for (usize i = 0; i < starts.size(); ++i) {
+            ASSERT_EQ(starts[i], expected.start(i)) << i;
+        }
+    }
+}
+
+// Test that comments are skipped and recorded as trivia
+TEST_F(LexTest, CommentsAndTrivia) {
+    std::string_view source = "-- header\n"
+                              "fn f() {- a {- nested -} comment -} {\n"
+                              "    x - -y -- trailing\n"
+                              "}\n"
+                              "{- unterminated";
+
+    TokenBuffer tokens = Lexer(source).tokenize_all();
+    std::vector<TokenKind> expected = {TokenKind::Fn,
+                                       TokenKind::Id,
+                                       TokenKind::LParen,
+                                       TokenKind::RParen,
+                                       TokenKind::LBrace,
+                                       TokenKind::Id,
+                                       TokenKind::Minus,
+                                       TokenKind::Minus,
+                                       TokenKind::Id,
+                                       TokenKind::RBrace,
+                                       TokenKind::Eof};
+    ASSERT_EQ(tokens.size(), expected.size());
+    for (usize i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(tokens.kind(i), expected[i]) << i;
+    }
+
+    TriviaTable trivia = collect_trivia(tokens);
+    ASSERT_EQ(trivia.token_count(), tokens.size());
+
+    // Leading trivia plus token text gives back the source
+    std::string rebuilt;
+    for (usize i = 0; i < tokens.size(); ++i) {
+        for (const auto& piece : trivia.leading(i)) {
+            rebuilt += source.substr(piece.start, piece.end - piece.start);
+        }
+        rebuilt += source.substr(tokens.start(i),
+                                 tokens.end(i) - tokens.start(i));
+    }
+    EXPECT_EQ(rebuilt, source);
+
+    auto header = trivia.leading(0);
+    ASSERT_EQ(header.size(), 2u);
+    EXPECT_EQ(header[0].kind, TriviaKind::LineComment);
+    EXPECT_EQ(header[1].kind, TriviaKind::Whitespace);
+
+    auto block = trivia.leading(4);
+    ASSERT_EQ(block.size(), 3u);
+    EXPECT_EQ(block[1].kind, TriviaKind::BlockComment);
+    EXPECT_EQ(source.substr(block[1].start, block[1].end - block[1].start),
+              "{- a {- nested -} comment -}");
+
+    auto tail = trivia.leading(tokens.size() - 1);
+    ASSERT_FALSE(tail.empty());
+    EXPECT_EQ(tail.back().kind, TriviaKind::BlockComment);
+    EXPECT_EQ(tail.back().end, source.size());
+}
+
+// Test that literal tokens are decoded once into the literal pool
+TEST_F(LexTest, LiteralPool) {
+    std::string_view source = R"(42 0xFF 0b101 0o17 1.5 2.5e-3 "plain" "a\tb\x{1F600}" 'c' '\n' 99999999999999999999 0x "bad\q" x)";
+
+    SourceText text(source);
+    TokenBuffer tokens = Lexer(text).tokenize_all();
+    LiteralPool pool   = decode_literals(tokens);
+    ASSERT_EQ(pool.size(), tokens.size() - 2); // all but `x` and Eof
+
+    EXPECT_EQ(pool.int_value(0), 42u);
+    EXPECT_EQ(pool.int_value(1), 255u);
+    EXPECT_EQ(pool.int_value(2), 5u);
+    EXPECT_EQ(pool.int_value(3), 15u);
+    EXPECT_EQ(pool.real_value(4), 1.5);
+    EXPECT_EQ(pool.real_value(5), 2.5e-3);
+
+    EXPECT_EQ(pool.str_value(6), "plain");
+    EXPECT_TRUE(pool.is_borrowed(6));
+    EXPECT_EQ(pool.str_value(6)->data(), text.data() + source.find("plain"));
+    EXPECT_EQ(pool.str_value(7), "a\tb\xF0\x9F\x98\x80");
+    EXPECT_FALSE(pool.is_borrowed(7));
+
+    EXPECT_EQ(pool.char_value(8), u32('c'));
+    EXPECT_EQ(pool.char_value(9), u32('\n'));
+
+    // Out of range, missing digits and unknown escapes have no value
+    EXPECT_FALSE(pool.is_valid(10));
+    EXPECT_FALSE(pool.is_valid(11));
+    EXPECT_FALSE(pool.is_valid(12));
+    EXPECT_FALSE(pool.int_value(6).has_value());
+
+    EXPECT_EQ(pool.find(7), 7u);
+    EXPECT_FALSE(pool.find(13).has_value());
+    EXPECT_FALSE(pool.find(tokens.size()).has_value());
+    EXPECT_EQ(pool.token(12), 12u);
+
+    // Refilling a pool drops the old literals
+    SourceText other("x 7");
+    decode_literals(Lexer(other).tokenize_all(), pool);
+    ASSERT_EQ(pool.size(), 1u);
+    EXPECT_FALSE(pool.find(0).has_value());
+    EXPECT_EQ(pool.find(1), 0u);
+    EXPECT_EQ(pool.int_value(0), 7u);
+}
+
+// Test tokens that run into the end of the input, and stray NUL bytes
+TEST_F(LexTest, LexerInputEnd) {
+    struct Case {
+        std::string_view source;
+        TokenKind kind;
+    };
+    for (auto [source, kind] : {Case{"abc", TokenKind::Id},
+                                Case{"0x", TokenKind::IntHex},
+                                Case{"1.5e", TokenKind::RealSci},
+                                Case{"\"ab\\", TokenKind::Str},
+                                Case{"'", TokenKind::Char},
+                                Case{"'\\", TokenKind::Char},
+                                Case{"-", TokenKind::Minus}}) {
+        Lexer lexer(source);
+        Token token = lexer.next();
+        EXPECT_EQ(token.kind, kind) << source;
+        EXPECT_EQ(token.end, source.size()) << source;
+        EXPECT_EQ(lexer.next().kind, TokenKind::Eof) << source;
+    }
+
+    // A NUL inside the text is an invalid byte, not the end
+    std::string_view source("a\0b", 3);
+    SourceText text(source);
+    Lexer lexer(text);
+    EXPECT_EQ(lexer.next().kind, TokenKind::Id);
+    EXPECT_EQ(lexer.next().kind, TokenKind::Invalid);
+    EXPECT_EQ(lexer.next().kind, TokenKind::Id);
+    Token eof = lexer.next();
+    EXPECT_EQ(eof.kind, TokenKind::Eof);
+    EXPECT_EQ(eof.start, 3u);
+}
+
+// Test Unicode identifiers and non-identifier characters
+TEST_F(LexTest, UnicodeIdentifiers) {
+    std::string_view source = "let naïve = 変数_1 + αβγ€ - _ü ∑x";
+    TokenBuffer tokens      = Lexer(source).tokenize_all();
+
+    struct Expected {
+        TokenKind kind;
+        std::string_view text;
+    };
+    std::vector<Expected> expected = {{TokenKind::Let, "let"},
+                                      {TokenKind::Id, "naïve"},
+                                      {TokenKind::Eq, "="},
+                                      {TokenKind::Id, "変数_1"},
+                                      {TokenKind::Plus, "+"},
+                                      {TokenKind::Id, "αβγ"},
+                                      {TokenKind::Invalid, "€"},
+                                      {TokenKind::Minus, "-"},
+                                      {TokenKind::Id, "_ü"},
+                                      {TokenKind::Invalid, "∑"},
+                                      {TokenKind::Id, "x"},
+                                      {TokenKind::Eof, ""}};
+    ASSERT_EQ(tokens.size(), expected.size());
+    for (usize i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(tokens.kind(i), expected[i].kind) << i;
+        EXPECT_EQ(source.substr(tokens.start(i),
+                                tokens.end(i) - tokens.start(i)),
+                  expected[i].text)
+            << i;
+    }
+
+    // Malformed sequences are consumed one byte at a time
+    Lexer lexer("\xC3\x28");
+    Token bad = lexer.next();
+    EXPECT_EQ(bad.kind, TokenKind::Invalid);
+    EXPECT_EQ(bad.end, 1u);
+}
+
+TEST_F(LexTest, TokenFingerprint) {
+    auto fingerprint = [](std::string_view source) {
+        return fingerprint_tokens(Lexer(source).tokenize_all());
+    };
+
+    auto base = fingerprint("let x = foo(1, \"a b\");");
+    EXPECT_EQ(fingerprint("let   x=foo( 1,\"a b\" ) ;"), base);
+    EXPECT_EQ(fingerprint("-- note\nlet x = {- c -} foo(1, \"a b\");\n"),
+              base);
+    EXPECT_EQ(fingerprint_tokens(
+                  Lexer(std::string_view("let x = foo(1, \"a b\");"))
+                      .tokenize_all(TokenStorage::Compact)),
+              base);
+
+    EXPECT_NE(fingerprint("let x = foo(2, \"a b\");"), base);
+    EXPECT_NE(fingerprint("let x = foo(1, \"a  b\");"), base);
+    EXPECT_NE(fingerprint("let xfoo = (1, \"a b\");"), base);
+    EXPECT_NE(fingerprint("let x = foo(1, \"a b\")"), base);
+    EXPECT_NE(fingerprint(""), base);
+    EXPECT_NE(base.lo, base.hi);
+}
@@ -1,6 +1,80 @@
 #include <gtest/gtest.h>
 #include "parse/parse.hh"
 #include "source_map/source_map.hh"
+#include <map>
+
+namespace {
+// 以 S 表达式打印 AST，叶子节点打印源码文本
+auto sexpr(const Ast& ast, std::string_view source, NodeIndex node)
+    -> std::string {
+    static const std::map<NodeKind, std::string_view> names = {
+        {NodeKind::Add, "+"},
+        {NodeKind::Sub, "-"},
+        {NodeKind::Mul, "*"},
+        {NodeKind::Div, "/"},
+        {NodeKind::Mod, "%"},
+        {NodeKind::AddAdd, "++"},
+        {NodeKind::BoolEq, "=="},
+        {NodeKind::BoolLt, "<"},
+        {NodeKind::BoolAnd, "and"},
+        {NodeKind::BoolOr, "or"},
+        {NodeKind::BoolNot, "not"},
+        {NodeKind::Negate, "neg"},
+        {NodeKind::Refer, "ref"},
+        {NodeKind::Deref, "deref"},
+        {NodeKind::OptionalType, "?"},
+        {NodeKind::PointerType, "ptr"},
+        {NodeKind::TypeCast, "as"},
+        {NodeKind::Select, "."},
+        {NodeKind::Call, "call"},
+        {NodeKind::IndexCall, "index"},
+        {NodeKind::ListOf, "list"},
+        {NodeKind::Tuple, "tuple"},
+        {NodeKind::Unit, "unit"},
+        {NodeKind::RangeFull, "range"},
+        {NodeKind::RangeTo, "range-to"},
+        {NodeKind::RangeToInclusive, "range-to="},
+        {NodeKind::RangeFrom, "range-from"},
+        {NodeKind::RangeFromTo, "range"},
+        {NodeKind::RangeFromToInclusive, "range="},
+        {NodeKind::ExprStatement, "stmt"},
+        {NodeKind::FileScope, "file"},
+        {NodeKind::FunctionDef, "fn"},
+        {NodeKind::ParamTyped, "param"},
+        {NodeKind::LetDecl, "let"},
+        {NodeKind::ReturnStatement, "return"},
+        {NodeKind::IfStatement, "if"},
+        {NodeKind::Block, "block"},
+    };
+
+    if (node == 0) {
+        return "_";
+    }
+    auto [kind, span, children] = *ast.get_node(node);
+    NodeType type               = get_node_type(kind);
+    if (type == NodeType::NoChild && kind != NodeKind::Unit
+        && kind != NodeKind::RangeFull) {
+        return std::string(source.substr(span.start, span.len()));
+    }
+
+    std::string out = "(" + std::string(names.at(kind));
+    for (usize i = 0; i < children.size(); ++i) {
+        bool multiple = type == NodeType::MultiChildren
+                        || ((type == NodeType::SingleWithMultiChildren
+                             || type == NodeType::FunctionDefChildren)
+                            && i == 1);
+        if (multiple) {
+            auto slice = *ast.get_multi_child_slice(children[i]);
+            for (NodeIndex child : slice) {
+                out += " " + sexpr(ast, source, child);
+            }
+        } else {
+            out += " " + sexpr(ast, source, children[i]);
+        }
+    }
+    return out + ")";
+}
+} // namespace
 
 class ParseTest : public ::testing::Test {
   protected:
@@ -12,6 +86,22 @@ class ParseTest : public ::testing::Test {
         // Setup code for each test
     }
 
+    // 解析单个表达式语句，返回表达式的 S 表达式
+    auto parse_expr(std::string_view source) -> std::string {
+        Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+        parser.parse(diag_ctx_);
+        Ast ast = parser.finalize();
+        if (ast.root() == 0) {
+            return "<error>";
+        }
+        auto statements
+            = *ast.get_multi_child_slice(ast.get_children(ast.root())[0]);
+        if (statements.size() != 1) {
+            return "<statements>";
+        }
+        return sexpr(ast, source, ast.get_children(statements[0])[0]);
+    }
+
     void TearDown() override {
         // Cleanup code for each test
     }
@@ -204,3 +294,610 @@ TEST_F(ParseTest, ParseErrorInheritance) {
     EXPECT_EQ(issue_ptr->message(), test_message);
     EXPECT_EQ(issue_ptr->level(), test_level);
 }
+
+// 测试基于 TokenBuffer 的前瞻和消费
+TEST_F(ParseTest, ParserOnTokenBuffer) {
+    std::string_view source = "let x = y;";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+
+    const TokenKind let_x[]  = {TokenKind::Let, TokenKind::Id};
+    const TokenKind let_eq[] = {TokenKind::Let, TokenKind::Eq};
+    EXPECT_TRUE(parser.peek(let_x));
+    EXPECT_FALSE(parser.peek(let_eq));
+
+    EXPECT_FALSE(parser.eat_token(TokenKind::Id));
+    EXPECT_TRUE(parser.eat_token(TokenKind::Let));
+    EXPECT_TRUE(parser.eat_token(TokenKind::Id));
+    EXPECT_EQ(parser.current_span(), Span(0, 5));
+    EXPECT_EQ(parser.next_token_span(), Span(6, 7));
+
+    parser.eat_tokens(3);
+    EXPECT_EQ(parser.peek_next_token().kind, TokenKind::Eof);
+}
+
+// 测试紧凑 token 存储下的跨度计算
+TEST_F(ParseTest, ParserOnCompactTokens) {
+    std::string_view source = "let name = \"str\";";
+    Parser parser(&source_map_,
+                  Lexer(source).tokenize_all(TokenStorage::Compact),
+                  10);
+
+    parser.eat_tokens(2);
+    EXPECT_EQ(parser.current_span(), Span(10, 18));
+    parser.eat_token(TokenKind::Eq);
+    EXPECT_EQ(parser.next_token_span(), Span(21, 26));
+}
+
+// 测试流式 token 源：结果与完整 TokenBuffer 一致，且驻留窗口有界
+TEST_F(ParseTest, ParserOnTokenStream) {
+    std::string source;
+    for (int i = 0; i < 20000; ++i) {
+        source += "let x = y; ";
+    }
+
+    Parser buffered(&source_map_, Lexer(source).tokenize_all(), 0);
+    Parser streaming(&source_map_, Lexer(source), 0);
+
+    usize max_window = 0;
+    while (true) {
+        Token expected = buffered.next_token();
+        Token actual   = streaming.next_token();
+        EXPECT_EQ(actual.kind, expected.kind);
+        EXPECT_EQ(actual.start, expected.start);
+        EXPECT_EQ(actual.end, expected.end);
+        max_window = std::max(max_window, streaming.token_window_size());
+        if (expected.kind == TokenKind::Eof) {
+            break;
+        }
+    }
+    EXPECT_LT(max_window, 10000u);
+    EXPECT_EQ(streaming.current_span(), buffered.current_span());
+
+    // 守卫内的 token 在退出前不会被释放
+    Parser guarded(&source_map_, Lexer(source), 0);
+    {
+        auto guard = guarded.scoped_guard();
+        guarded.eat_tokens(50000);
+        EXPECT_EQ(guarded.current_span(), Span(0, 109999));
+        EXPECT_GT(guarded.token_window_size(), 50000u);
+    }
+    guarded.eat_tokens(1);
+    EXPECT_LT(guarded.token_window_size(), 10000u);
+}
+
+// 测试仅空白改动后平移 AST 跨度
+TEST_F(ParseTest, RemapAstSpans) {
+    std::string_view before = "let x = y;";
+    std::string_view after  = "  let   x=y ;";
+    auto old_tokens         = Lexer(before).tokenize_all();
+    auto new_tokens         = Lexer(after).tokenize_all();
+    ASSERT_EQ(fingerprint_tokens(old_tokens), fingerprint_tokens(new_tokens));
+
+    Ast ast;
+    auto x    = ast.add_node(NodeBuilder(NodeKind::Id, Span(104, 105)));
+    auto y    = ast.add_node(NodeBuilder(NodeKind::Id, Span(108, 109)));
+    auto stmt = ast.add_node(NodeBuilder(NodeKind::Id, Span(100, 110)));
+    auto mark = ast.add_node(NodeBuilder(NodeKind::Id, Span(109, 109)));
+
+    remap_ast_spans(ast, old_tokens, new_tokens, 100);
+    EXPECT_EQ(ast.get_span(x), Span(108, 109));
+    EXPECT_EQ(ast.get_span(y), Span(110, 111));
+    EXPECT_EQ(ast.get_span(stmt), Span(102, 113));
+    EXPECT_EQ(ast.get_span(mark), Span(112, 112));
+}
+
+// 测试 Pratt 表达式解析：优先级、结合性与各类节点
+TEST_F(ParseTest, PrattExpressions) {
+    EXPECT_EQ(parse_expr("1 + 2 * 3;"), "(+ 1 (* 2 3))");
+    EXPECT_EQ(parse_expr("1 - 2 - 3;"), "(- (- 1 2) 3)");
+    EXPECT_EQ(parse_expr("(1 + 2) * 3;"), "(* (+ 1 2) 3)");
+    EXPECT_EQ(parse_expr("a or b and c == d;"), "(or a (and b (== c d)))");
+    EXPECT_EQ(parse_expr("a < b + c % d;"), "(< a (+ b (% c d)))");
+    EXPECT_EQ(parse_expr("s ++ t ++ u;"), "(++ (++ s t) u)");
+    EXPECT_EQ(parse_expr("-x * y;"), "(* (neg x) y)");
+    EXPECT_EQ(parse_expr("not a.b and !c;"), "(and (not (. a b)) (not c))");
+    EXPECT_EQ(parse_expr("-x as f64 + 1;"), "(+ (as (neg x) f64) 1)");
+    EXPECT_EQ(parse_expr("&p.*;"), "(ref (deref p))");
+    EXPECT_EQ(parse_expr("?*T;"), "(? (ptr T))");
+
+    EXPECT_EQ(parse_expr("f(a, b + 1)(c);"), "(call (call f a (+ b 1)) c)");
+    EXPECT_EQ(parse_expr("f();"), "(call f)");
+    EXPECT_EQ(parse_expr("xs[i + 1].len;"), "(. (index xs (+ i 1)) len)");
+    EXPECT_EQ(parse_expr("t.0;"), "(. t 0)");
+    EXPECT_EQ(parse_expr("self.items[0];"), "(index (. self items) 0)");
+
+    EXPECT_EQ(parse_expr("[1, \"a\", 'c', 2.5,];"), "(list 1 \"a\" 'c' 2.5)");
+    EXPECT_EQ(parse_expr("[];"), "(list)");
+    EXPECT_EQ(parse_expr("(a, b);"), "(tuple a b)");
+    EXPECT_EQ(parse_expr("();"), "(unit)");
+    EXPECT_EQ(parse_expr("true and null == false;"), "(and true (== null false))");
+
+    EXPECT_EQ(parse_expr("0..n + 1;"), "(range 0 (+ n 1))");
+    EXPECT_EQ(parse_expr("a..=b;"), "(range= a b)");
+    EXPECT_EQ(parse_expr("1..;"), "(range-from 1)");
+    EXPECT_EQ(parse_expr("..5;"), "(range-to 5)");
+    EXPECT_EQ(parse_expr("..=x.y;"), "(range-to= (. x y))");
+    EXPECT_EQ(parse_expr("..;"), "(range)");
+    EXPECT_EQ(parse_expr("xs[1..];"), "(index xs (range-from 1))");
+    EXPECT_EQ(parse_expr("a..b == c;"), "(== (range a b) c)");
+}
+
+// 测试表达式节点跨度与解析错误
+TEST_F(ParseTest, PrattSpansAndErrors) {
+    std::string_view source = "  f(a) + b.c;\nx;";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 100);
+    parser.parse(diag_ctx_);
+    Ast ast    = parser.finalize();
+
+    auto file  = ast.root();
+    auto stmts = *ast.get_multi_child_slice(ast.get_children(file)[0]);
+    ASSERT_EQ(stmts.size(), 2u);
+    EXPECT_EQ(ast.get_span(file), Span(102, 116));
+    EXPECT_EQ(ast.get_span(stmts[0]), Span(102, 113));
+    auto add = ast.get_children(stmts[0])[0];
+    EXPECT_EQ(ast.get_node_kind(add), NodeKind::Add);
+    EXPECT_EQ(ast.get_span(add), Span(102, 112));
+    EXPECT_EQ(ast.get_span(ast.get_children(add)[0]), Span(102, 106));
+    EXPECT_EQ(ast.get_span(ast.get_children(add)[1]), Span(109, 112));
+
+    EXPECT_EQ(parse_expr("1 +;"), "<error>");
+    EXPECT_EQ(parse_expr("f(a b);"), "<error>");
+    EXPECT_EQ(parse_expr("a..=;"), "<error>");
+    EXPECT_EQ(parse_expr("a.;"), "<error>");
+    EXPECT_EQ(parse_expr("1 + 2"), "<error>");
+}
+
+// 测试 packrat 记忆：回溯后重新解析同一规则直接命中
+TEST_F(ParseTest, PackratMemo) {
+    std::string_view source = "f(a + b, c)[0] * 2;";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+    parser.enable_memo(64);
+
+    auto guard = parser.scoped_guard();
+    auto first = parser.parse_expr();
+    ASSERT_TRUE(first.has_value());
+    usize misses = parser.memo_stats().misses;
+    EXPECT_EQ(parser.memo_stats().hits, 0u);
+
+    parser.backtrack();
+    EXPECT_EQ(parser.peek_next_token().kind, TokenKind::Id);
+    auto second = parser.parse_expr();
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(*second, *first);
+    EXPECT_EQ(parser.memo_stats().hits, 1u);
+    EXPECT_EQ(parser.memo_stats().misses, misses);
+    EXPECT_EQ(parser.memo_stats().saved_tokens, 13u);
+    EXPECT_EQ(parser.peek_next_token().kind, TokenKind::Semi);
+
+    // 失败同样被记忆
+    Parser failing(&source_map_, Lexer("(1 +;").tokenize_all(), 0);
+    failing.enable_memo(64);
+    auto failing_guard = failing.scoped_guard();
+    EXPECT_FALSE(failing.parse_expr().has_value());
+    failing.backtrack();
+    auto error = failing.parse_expr();
+    ASSERT_FALSE(error.has_value());
+    EXPECT_EQ(error.error().kind(), ParseErrorKind::ExpectedToken);
+    EXPECT_EQ(failing.memo_stats().hits, 1u);
+
+    // 容量为 1 时不断替换，结果仍然正确
+    Parser tiny(&source_map_, Lexer(source).tokenize_all(), 0);
+    tiny.enable_memo(1);
+    auto tiny_guard = tiny.scoped_guard();
+    ASSERT_TRUE(tiny.parse_expr().has_value());
+    EXPECT_GT(tiny.memo_stats().evictions, 0u);
+    EXPECT_EQ(tiny.peek_next_token().kind, TokenKind::Semi);
+
+    // 未启用时不计数
+    Parser plain(&source_map_, Lexer(source).tokenize_all(), 0);
+    ASSERT_TRUE(plain.parse_expr().has_value());
+    EXPECT_EQ(plain.memo_stats().misses, 0u);
+}
+
+// 测试函数、参数、语句与控制流的解析
+TEST_F(ParseTest, FunctionsAndStatements) {
+    std::string_view source = "fn area(self, w: int, h: ?int) -> int {\n"
+                              "    let a: int = w * h;\n"
+                              "    if a < 0 { return; } else if a == 0 {\n"
+                              "        log(a);\n"
+                              "    } else { { a; } }\n"
+                              "    return a;\n"
+                              "}\n"
+                              "fn nop() {}\n"
+                              "run();\n";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+    parser.parse(diag_ctx_);
+    Ast ast = parser.finalize();
+    ASSERT_NE(ast.root(), 0u);
+    EXPECT_EQ(sexpr(ast, source, ast.root()),
+              "(file (fn area self (param w int) (param h (? int)) int "
+              "(block (let a int (* w h)) "
+              "(if (< a 0) (block (return _)) "
+              "(if (== a 0) (block (stmt (call log a))) "
+              "(block (block (stmt a))))) "
+              "(return a))) "
+              "(fn nop _ (block)) (stmt (call run)))");
+
+    for (std::string_view bad : {"fn f(a) {}", "fn f() { let = 1; }",
+                                 "fn f() { return 1 }", "fn f() {",
+                                 "if a {} else b;"}) {
+        Parser failing(&source_map_, Lexer(bad).tokenize_all(), 0);
+        EXPECT_FALSE(failing.parse_file().has_value()) << bad;
+    }
+}
+
+// 测试惰性函数体：跳过函数体，按需再解析，结果与完整解析一致
+TEST_F(ParseTest, LazyFunctionBodies) {
+    std::string_view source = "fn f(x: int) { let y = x; if y { { g(); } } }\n"
+                              "fn h() { return [1..2]; }\n"
+                              "top(1);\n";
+    // 放在第二个文件里，跨度带有非零的全局偏移
+    SourceMap source_map;
+    source_map.add_file("other.bl", "x;\n");
+    FileId file_id = source_map.add_file("lazy.bl", String(source));
+    u32 start_pos  = source_map.get_file(file_id)->start_pos;
+
+    auto tokens = Lexer(source).tokenize_all();
+    Parser eager(&source_map, tokens, start_pos);
+    ASSERT_TRUE(eager.parse_file().has_value());
+    Ast expected = eager.finalize();
+
+    Parser lazy(&source_map, tokens, start_pos);
+    lazy.set_lazy_bodies(true);
+    ASSERT_TRUE(lazy.parse_file().has_value());
+    Ast ast = lazy.finalize();
+    EXPECT_LT(ast.nodes().size(), expected.nodes().size());
+
+    // 展开会追加子节点存储，先复制出来
+    auto slice = *ast.get_multi_child_slice(ast.get_children(ast.root())[0]);
+    std::vector<NodeIndex> items(slice.begin(), slice.end());
+    ASSERT_EQ(items.size(), 3u);
+    NodeIndex body = ast.get_children(items[0])[3];
+    EXPECT_EQ(ast.get_node_kind(body), NodeKind::LazyBlock);
+    EXPECT_EQ(*source_map.get_span_text(*ast.get_span(body)),
+              "{ let y = x; if y { { g(); } } }");
+
+    // 展开后与完整解析的结构和跨度一致，节点下标不变
+    auto expanded = expand_function_body(ast, source_map, items[0]);
+    ASSERT_TRUE(expanded.has_value());
+    EXPECT_EQ(*expanded, body);
+    EXPECT_EQ(ast.get_node_kind(body), NodeKind::Block);
+    ASSERT_TRUE(expand_function_body(ast, source_map, items[1]).has_value());
+
+    auto shifted = [&](const Ast& tree) {
+        std::string text(start_pos, ' ');
+        return sexpr(tree, text + std::string(source), tree.root());
+    };
+    EXPECT_EQ(shifted(ast), shifted(expected));
+    EXPECT_EQ(*source_map.get_span_text(*ast.get_span(body)),
+              "{ let y = x; if y { { g(); } } }");
+
+    // 再次展开直接返回；非函数节点报错
+    usize nodes = ast.nodes().size();
+    EXPECT_EQ(expand_function_body(ast, source_map, items[0]).value_or(0),
+              body);
+    EXPECT_EQ(ast.nodes().size(), nodes);
+    EXPECT_FALSE(expand_function_body(ast, source_map, items[2]));
+
+    // 未闭合的函数体在跳过时就报错
+    Parser unclosed(&source_map, Lexer("fn f() { {}").tokenize_all(), 0);
+    unclosed.set_lazy_bodies(true);
+    auto error = unclosed.parse_file();
+    ASSERT_FALSE(error.has_value());
+    EXPECT_EQ(error.error().kind(), ParseErrorKind::MissingBrace);
+}
+
+// 测试并行解析：各顶层项分块解析后拼接，结果与串行解析一致
+TEST_F(ParseTest, ParallelParseMatchesSerial) {
+    std::string source;
+    for (int i = 0; i < 200; ++i) {
+        source += std::format("fn f{}(self, x: int) -> ?int {{\n", i);
+        source += "    let y = g(x, [1..x]) * (x + 1);\n";
+        source += "    if y < 0 { return; } else { h(y); }\n";
+        source += "    return y.value;\n}\n";
+        if (i % 7 == 0) {
+            source += std::format("main({});\n", i);
+        }
+    }
+    TokenBuffer tokens = Lexer(source).tokenize_all();
+
+    for (bool lazy : {false, true}) {
+        Parser serial(&source_map_, tokens, 5);
+        serial.set_lazy_bodies(lazy);
+        ASSERT_TRUE(serial.parse_file().has_value());
+        Ast expected = serial.finalize();
+
+        for (usize threads : {1, 2, 4, 7}) {
+            auto ast = parse_file_parallel(&source_map_,
+                                           tokens,
+                                           5,
+                                           {.threads          = threads,
+                                            .min_chunk_tokens = 16,
+                                            .lazy_bodies      = lazy});
+            ASSERT_TRUE(ast.has_value());
+            EXPECT_TRUE(*ast == expected) << threads << " threads";
+        }
+    }
+
+    // 出错时与串行解析报告同一个错误
+    std::string broken = source;
+    broken.insert(broken.find("fn f150"), "x + ;\n");
+    TokenBuffer broken_tokens = Lexer(broken).tokenize_all();
+    Parser serial(&source_map_, broken_tokens, 0);
+    auto expected = serial.parse_file();
+    ASSERT_FALSE(expected.has_value());
+    auto error = parse_file_parallel(&source_map_,
+                                     broken_tokens,
+                                     0,
+                                     {.threads = 4, .min_chunk_tokens = 16});
+    ASSERT_FALSE(error.has_value());
+    EXPECT_EQ(error.error().span(), expected.error().span());
+    EXPECT_EQ(error.error().message(), expected.error().message());
+}
+
+// 测试增量重解析：只重新解析改动所在的块或条目，结果与从头解析一致
+TEST_F(ParseTest, IncrementalReparse) {
+    std::string before = "fn f(x: int) {\n"
+                         "    let y = g(x);\n"
+                         "    if y < 0 { return; } else { h(y); }\n"
+                         "    return y;\n"
+                         "}\n"
+                         "main(1);\n"
+                         "fn k() { k(); }\n";
+
+    struct Edit {
+        std::string_view find;
+        std::string_view with;
+        bool local; // 只重新解析一个块或条目
+    };
+    std::vector<Edit> edits = {
+        {"g(x)", "g(x, 2)", true},          // 函数体内
+        {"return;", "return 1;", true},     // 嵌套的 then 块
+        {"h(y);", "h(y + 1); h(y);", true}, // else 块多出一条语句
+        {"return y;", "  return  y ;", true}, // 只改空白
+        {"main(1)", "main(1 + 2)", true},   // 顶层语句
+        {"fn k()", "fn kk(self)", true},    // 函数签名
+        {"fn k", "x;\nfn k", false},        // 新增条目
+        {"{ return; }", "{ return; }}", false}, // 括号不再配对
+        {"main(1)", "main(1 +)", false},    // 语法错误
+    };
+
+    for (bool lazy : {false, true}) {
+        Parser parser(&source_map_, Lexer(before).tokenize_all(), 3);
+        parser.set_lazy_bodies(lazy);
+        ASSERT_TRUE(parser.parse_file().has_value());
+        Ast old_ast = parser.finalize();
+        auto nodes  = static_cast<NodeIndex>(old_ast.nodes().size() - 1);
+
+        for (const auto& edit : edits) {
+            auto start        = static_cast<u32>(before.find(edit.find));
+            std::string after = before;
+            after.replace(start, edit.find.size(), edit.with);
+
+            TokenBuffer old_tokens = Lexer(before).tokenize_all();
+            RelexResult relexed    = Lexer(after).relex(
+                old_tokens,
+                Span(start, start + static_cast<u32>(edit.find.size())),
+                edit.with);
+            auto result = reparse(
+                &source_map_, old_ast, old_tokens, relexed, 3, lazy);
+
+            Parser full(&source_map_, Lexer(after).tokenize_all(), 3);
+            full.set_lazy_bodies(lazy);
+            auto expected = full.parse_file();
+            if (!expected) {
+                ASSERT_FALSE(result.has_value()) << edit.with;
+                EXPECT_EQ(result.error().span(), expected.error().span());
+                continue;
+            }
+            ASSERT_TRUE(result.has_value()) << edit.with;
+            EXPECT_TRUE(result->ast == full.finalize()) << edit.with;
+
+            ASSERT_EQ(result->replaced.size(), 1u);
+            const ReplacedNodes& replaced = result->replaced[0];
+            bool whole = replaced.old_first == 1 && replaced.old_last == nodes;
+            EXPECT_EQ(whole, !edit.local) << edit.with << " lazy=" << lazy;
+            EXPECT_EQ(result->ast.nodes().size() - 1,
+                      nodes + replaced.new_last - replaced.old_last);
+        }
+    }
+}
+
+// 测试错误恢复：跳到同步点后继续解析，一次报告全部语法错误
+TEST_F(ParseTest, ErrorRecovery) {
+    std::string source = "a + ;\n"
+                         "fn f(x: int) { let = 1; g(x); h(; }\n"
+                         "ok(1);\n"
+                         "} stray;\n"
+                         "struct S { a: int }\n"
+                         "fn g() { return 1 }\n"
+                         "last;\n";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+    auto result = parser.parse_file();
+    ASSERT_FALSE(result.has_value());
+
+    // 每个出错的条目或语句各报告一次，按出现顺序：`a + ;`、`let = 1;`、
+    // `h(;`、多余的 `}`、不支持的 struct 和缺少 `;` 的 return
+    usize expected = 6;
+    ASSERT_EQ(parser.errors().size(), expected);
+    u32 previous = 0;
+    for (const ParseError& error : parser.errors()) {
+        EXPECT_GE(error.span().start, previous);
+        previous = error.span().start;
+    }
+    EXPECT_EQ(parser.errors()[1].span().start, source.find("= 1"));
+    EXPECT_EQ(parser.errors()[3].span().start, source.find("} stray"));
+    EXPECT_EQ(result.error().span(), parser.errors()[0].span());
+
+    // parse 把全部错误成批发射
+    DiagCtxt diag_ctx;
+    Parser batch(&source_map_, Lexer(source).tokenize_all(), 0);
+    batch.parse(diag_ctx);
+    EXPECT_EQ(diag_ctx.error_count(), expected);
+
+    // 错误数有上限
+    std::string many;
+    for (int i = 0; i < 300; ++i) {
+        many += "a + ;\n";
+    }
+    Parser capped(&source_map_, Lexer(many).tokenize_all(), 0);
+    EXPECT_FALSE(capped.parse_file().has_value());
+    EXPECT_EQ(capped.errors().size(), Parser::MAX_ERRORS);
+
+    // 一次同步跳过的 token 有上限，超出后停止解析
+    std::string runaway = "a + ;\n{ ";
+    for (usize i = 0; i < 2 * Parser::MAX_RESYNC_TOKENS; ++i) {
+        runaway += "x ";
+    }
+    runaway += "}\nb + ;\n";
+    Parser bounded(&source_map_, Lexer(runaway).tokenize_all(), 0);
+    EXPECT_FALSE(bounded.parse_file().has_value());
+    ASSERT_EQ(bounded.errors().size(), 3u);
+    EXPECT_EQ(bounded.errors().back().level(), DiagLevel::Note);
+}
+
+// 测试深层嵌套：显式栈解析不耗尽原生栈，超过深度上限时报错
+TEST_F(ParseTest, DeepNesting) {
+    constexpr usize depth = 100000;
+    auto repeat = [](std::string_view text, usize count) {
+        std::string out;
+        out.reserve(text.size() * count);
+        for (usize i = 0; i < count; ++i) {
+            out += text;
+        }
+        return out;
+    };
+
+    // 嵌套深度只受堆内存限制，不会耗尽原生栈
+    std::vector<std::string> sources = {
+        repeat("(", depth) + "x" + repeat(")", depth) + ";\n",
+        repeat("- ", depth) + "x;\n",
+        repeat("f(", depth) + repeat(")", depth) + ";\n",
+        repeat("[", depth) + repeat("]", depth) + ";\n",
+        "fn f() " + repeat("{ ", depth) + repeat("} ", depth) + "\n",
+        "fn f() { if a { b; }" + repeat(" else if a { b; }", depth)
+            + " else { c; } }\n",
+    };
+    for (const std::string& source : sources) {
+        Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+        EXPECT_TRUE(parser.parse_file().has_value()) << source.substr(0, 20);
+    }
+
+    // 嵌套层数有可配置的上限，超出时报告语法错误
+    std::string deep = repeat("(", 2000) + "x" + repeat(")", 2000) + ";\n";
+    Parser limited(&source_map_, Lexer(deep).tokenize_all(), 0);
+    limited.set_max_nesting(1000);
+    auto result = limited.parse_file();
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().kind(), ParseErrorKind::NestingTooDeep);
+
+    std::string blocks = "fn f() " + repeat("{ ", 2000) + repeat("} ", 2000);
+    Parser nested(&source_map_, Lexer(blocks).tokenize_all(), 0);
+    nested.set_max_nesting(1000);
+    ASSERT_FALSE(nested.parse_file().has_value());
+    EXPECT_EQ(nested.errors().front().kind(), ParseErrorKind::NestingTooDeep);
+
+    // 上限以内照常解析
+    Parser shallow(&source_map_, Lexer(deep).tokenize_all(), 0);
+    shallow.set_max_nesting(4000);
+    EXPECT_TRUE(shallow.parse_file().has_value());
+}
+
+// 测试跨文件复用 ParseContext：结果与每个文件新建 Parser 一致
+TEST_F(ParseTest, ParseContextReuse) {
+    std::vector<std::string> sources;
+    for (int i = 0; i < 20; ++i) {
+        sources.push_back(std::format("fn f{}(x: int) {{ g(x, {}); }}\n"
+                                      "let y = [1, 2, x.{}];\n",
+                                      i,
+                                      i,
+                                      i));
+    }
+    sources.insert(sources.begin() + 5, "fn bad( { }\nlet = 1;\n");
+
+    // 复用的上下文与每个文件新建 Parser 的结果逐节点相同，
+    // 出错的文件不影响之后的文件
+    for (bool lazy : {false, true}) {
+        ParseContext context(&source_map_);
+        context.set_lazy_bodies(lazy);
+        for (const std::string& source : sources) {
+            SourceText text(source);
+            TokenBuffer tokens = Lexer(text).tokenize_all();
+            Parser fresh(&source_map_, tokens, 7);
+            fresh.set_lazy_bodies(lazy);
+            bool ok = fresh.parse_file().has_value();
+
+            const TokenBuffer& reused = context.lex(text);
+            ASSERT_EQ(reused.size(), tokens.size());
+            auto ast = context.parse(7);
+            ASSERT_EQ(ast.has_value(), ok) << source;
+            if (!ok) {
+                EXPECT_EQ(ast.error().size(), fresh.errors().size());
+                continue;
+            }
+            EXPECT_TRUE(*ast == fresh.finalize()) << source;
+        }
+    }
+}
+
+// 测试解析时读取字面量池：无法解码的字面量报错，合法的照常解析
+TEST_F(ParseTest, LiteralPoolConsumer) {
+    ParseContext context(&source_map_);
+
+    SourceText good("let a = 0xFF + 1.5;\nlet s = \"a\\tb\";\n");
+    context.lex(good);
+    ASSERT_TRUE(context.parse(0).has_value());
+    EXPECT_EQ(context.literals().size(), 3u);
+    EXPECT_EQ(context.literals().int_value(0), 255u);
+
+    SourceText bad("let a = 99999999999999999999;\nlet b = 0x;\n"
+                   "let c = \"\\q\";\nlet d = 1;\n");
+    context.lex(bad);
+    auto ast = context.parse(0);
+    ASSERT_FALSE(ast.has_value());
+    ASSERT_EQ(ast.error().size(), 3u);
+    for (const ParseError& error : ast.error()) {
+        EXPECT_EQ(error.kind(), ParseErrorKind::InvalidToken);
+    }
+    EXPECT_EQ(ast.error()[1].span(), Span(38, 40));
+
+    // 不设置字面量池的 Parser 不检查字面量
+    Parser parser(&source_map_, Lexer(bad).tokenize_all(), 0);
+    EXPECT_TRUE(parser.parse_file().has_value());
+}
+
+// 测试编译期文法组合子
+TEST_F(ParseTest, GrammarCombinators) {
+    using namespace grammar;
+    using LetName = Seq<Tok<TokenKind::Let>, Tok<TokenKind::Id>>;
+    using Typed   = Seq<Tok<TokenKind::Colon>, Tok<TokenKind::Id>>;
+    using Let     = Seq<LetName, Opt<Typed>, Tok<TokenKind::Eq>>;
+    using Path    = Seq<Tok<TokenKind::Id>,
+                        Rep<Seq<Tok<TokenKind::Dot>, Tok<TokenKind::Id>>>>;
+    using Head    = Alt<Let, Path, Tok<TokenKind::Return>>;
+
+    // FIRST 集与分派表在编译期算出
+    static_assert(starts<Head>(TokenKind::Let));
+    static_assert(starts<Head>(TokenKind::Id));
+    static_assert(!starts<Head>(TokenKind::Eq));
+    static_assert(!Head::NULLABLE && Opt<Typed>::NULLABLE);
+    static_assert(Head::dispatch(TokenKind::Id) == 1);
+    static_assert(Head::dispatch(TokenKind::Eq) == Head::NONE);
+    static_assert(starts<Seq<Opt<Typed>, Tok<TokenKind::Eq>>>(TokenKind::Eq));
+
+    std::string_view source = "let x: int = a.b.c;";
+    Parser parser(&source_map_, Lexer(source).tokenize_all(), 0);
+    EXPECT_TRUE(parser.peek_rule<Head>());
+    EXPECT_FALSE(parser.peek_rule<Path>());
+    EXPECT_TRUE(parser.eat_rule<Let>());
+    EXPECT_EQ(parser.next_token_span(), Span(13, 14));
+
+    // 选中的分支失败时整体失败，游标不动
+    using PathComma = Seq<Path, Tok<TokenKind::Comma>>;
+    EXPECT_FALSE(parser.eat_rule<PathComma>());
+    EXPECT_EQ(parser.next_token_span(), Span(13, 14));
+    EXPECT_TRUE(parser.eat_rule<Head>());
+    EXPECT_TRUE(parser.eat_rule<Tok<TokenKind::Semi>>());
+    EXPECT_FALSE(parser.eat_rule<Head>());
+    EXPECT_EQ(parser.peek_next_token().kind, TokenKind::Eof);
+}
@@ -105,6 +105,20 @@ TEST_F(SourceMapTest, LocationToBytePos) {
     EXPECT_FALSE(invalid_pos.has_value());
 }
 
+// Test that source text is followed by a zeroed sentinel padding
+TEST_F(SourceMapTest, SourceTextPadding) {
+    SourceText text("fn main()");
+    EXPECT_EQ(text.size(), 9u);
+    EXPECT_EQ(text, "fn main()");
+    for (usize i = 0; i < SourceText::PADDING; ++i) {
+        EXPECT_EQ(text.data()[text.size() + i], '\0');
+    }
+
+    SourceText empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.data()[0], '\0');
+}
+
 // Test SourceMap file management
 TEST_F(SourceMapTest, SourceMapFileManagement) {
     SourceMap source_map;
@@ -273,3 +287,36 @@ TEST_F(SourceMapTest, LoadFile) {
     ASSERT_TRUE(found_id.has_value());
     EXPECT_EQ(*found_id, *file_id);
 }
+
+// Test UTF-8 validation of loaded files, across vector block boundaries
+TEST_F(SourceMapTest, Utf8Validation) {
+    std::string valid;
+    for (int i = 0; i < 40; ++i) {
+        valid += "fn f() { \"é€😀\" } -- ünïcödé\n";
+    }
+    EXPECT_FALSE(find_invalid_utf8(valid).has_value());
+    EXPECT_FALSE(find_invalid_utf8("").has_value());
+
+    for (std::string_view bad : {"\x80",
+                                 "\xC0\xAF",
+                                 "\xED\xA0\x80",
+                                 "\xF4\x90\x80\x80",
+                                 "\xE2\x82",
+                                 "\xF0\x9F\x98"}) {
+        for (usize at : {0, 5, 31, 63, 100}) {
+            std::string text = valid.substr(0, at);
+            text += bad;
+            text += valid.substr(at, 50);
+            auto offset = find_invalid_utf8(text);
+            ASSERT_TRUE(offset.has_value()) << at;
+            EXPECT_GE(*offset, at > 0 ? at - 3 : 0) << at;
+            EXPECT_LE(*offset, at) << at;
+        }
+    }
+
+    SourceMap source_map;
+    FileId good = source_map.add_file("good.bl", valid);
+    FileId poor = source_map.add_file("poor.bl", "let x = \"\xFF\";");
+    EXPECT_FALSE(source_map.get_file(good)->invalid_utf8.has_value());
+    EXPECT_EQ(source_map.get_file(poor)->invalid_utf8, 9u);
+}
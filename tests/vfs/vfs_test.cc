@@ -260,6 +260,26 @@ TEST_F(VfsTest, SourceFileAndAstManagement) {
     auto retrieved_ast = vfs.get_ast(*main_id);
     ASSERT_TRUE(retrieved_ast.has_value());
     EXPECT_EQ((*retrieved_ast)->root(), root_node);
+
+    EXPECT_EQ(vfs.get_ast_file_id(*main_id), file_id);
+
+    // 测试 token 指纹：随 AST 一起设置，换上新 AST 时清除
+    EXPECT_FALSE(vfs.get_fingerprint(*main_id).has_value());
+    TokenFingerprint fingerprint{1, 2};
+    auto taken = vfs.take_ast(*main_id);
+    ASSERT_NE(taken, nullptr);
+    EXPECT_FALSE(vfs.get_ast(*main_id).has_value());
+    EXPECT_TRUE(vfs.set_ast(*main_id, std::move(taken), fingerprint));
+    EXPECT_EQ(vfs.get_fingerprint(*main_id), fingerprint);
+    EXPECT_TRUE(vfs.set_ast(*main_id, std::make_unique<Ast>()));
+    EXPECT_FALSE(vfs.get_fingerprint(*main_id).has_value());
+    EXPECT_FALSE(vfs.set_ast(vfs.root_node_id(), nullptr, fingerprint));
+    ASSERT_TRUE(vfs.get_ast_mut(*main_id).has_value());
+
+    // 取出 AST 后指纹和生成时的源文件一并清除
+    EXPECT_NE(vfs.take_ast(*main_id), nullptr);
+    EXPECT_FALSE(vfs.get_ast_file_id(*main_id).has_value());
+    EXPECT_EQ(vfs.take_ast(*main_id), nullptr);
 }
 
 TEST_F(VfsTest, GetEntryFile) {
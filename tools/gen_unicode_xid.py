@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Generates src/lex/unicode_xid.cc, the XID_Start / XID_Continue tables.
+
+The properties come from the running Python's unicodedata (str.isidentifier
+checks XID_Start and XID_Continue). Code points are split into 128-wide
+blocks; each block maps through a one-byte index to a deduplicated leaf
+holding the start and continue bitmaps, so a lookup is two loads and a bit
+test.
+
+Usage: python3 tools/gen_unicode_xid.py > src/lex/unicode_xid.cc
+"""
+
+import sys
+import unicodedata
+
+BLOCK_BITS = 7
+BLOCK = 1 << BLOCK_BITS
+# Past this, only the variation selectors U+E0100..U+E01EF are XID_Continue,
+# and those are tested directly.
+LIMIT = 0x32400
+
+
+def xid_start(cp):
+    return cp != ord("_") and chr(cp).isidentifier()
+
+
+def xid_continue(cp):
+    return ("a" + chr(cp)).isidentifier()
+
+
+def bitmap(prop, block):
+    bits = 0
+    for i in range(BLOCK):
+        if prop(block * BLOCK + i):
+            bits |= 1 << i
+    return bits
+
+
+def words(bits):
+    return [(bits >> (64 * i)) & (2**64 - 1) for i in range(BLOCK // 64)]
+
+
+def main():
+    assert all(
+        not xid_start(cp) and (xid_continue(cp) == (0xE0100 <= cp <= 0xE01EF))
+        for cp in range(LIMIT, 0x110000)
+    )
+
+    leaves = []
+    leaf_index = {}
+    index = []
+    for block in range(LIMIT // BLOCK):
+        leaf = (bitmap(xid_start, block), bitmap(xid_continue, block))
+        if leaf not in leaf_index:
+            leaf_index[leaf] = len(leaves)
+            leaves.append(leaf)
+        index.append(leaf_index[leaf])
+    assert len(leaves) <= 256
+
+    out = sys.stdout
+    out.write("// Generated by tools/gen_unicode_xid.py from Unicode ")
+    out.write(unicodedata.unidata_version + ". Do not edit.\n\n")
+    out.write('#include "lex/unicode_xid.hh"\n\n')
+    out.write("namespace {\n\n")
+    out.write("struct XidLeaf {\n")
+    out.write("    u64 start[2];\n")
+    out.write("    u64 cont[2];\n")
+    out.write("};\n\n")
+    out.write(f"constexpr u32 XID_LIMIT = 0x{LIMIT:X};\n\n")
+    out.write(f"constexpr u8 XID_INDEX[{len(index)}] = {{\n")
+    for i in range(0, len(index), 16):
+        row = ", ".join(f"{v}" for v in index[i : i + 16])
+        out.write(f"    {row},\n")
+    out.write("};\n\n")
+    out.write(f"constexpr XidLeaf XID_LEAVES[{len(leaves)}] = {{\n")
+    for start, cont in leaves:
+        s = ", ".join(f"0x{w:016X}" for w in words(start))
+        c = ", ".join(f"0x{w:016X}" for w in words(cont))
+        out.write(f"    {{{{{s}}},\n     {{{c}}}}},\n")
+    out.write("};\n\n")
+    out.write("constexpr auto bit(const u64* words, u32 cp) -> bool {\n")
+    out.write("    u32 offset = cp & 127;\n")
+    out.write("    return (words[offset >> 6] >> (offset & 63)) & 1;\n")
+    out.write("}\n\n")
+    out.write("} // namespace\n\n")
+    out.write("auto is_xid_start(u32 cp) -> bool {\n")
+    out.write("    if (cp >= XID_LIMIT) {\n")
+    out.write("        return false;\n")
+    out.write("    }\n")
+    out.write("    return bit(XID_LEAVES[XID_INDEX[cp >> 7]].start, cp);\n")
+    out.write("}\n\n")
+    out.write("auto is_xid_continue(u32 cp) -> bool {\n")
+    out.write("    if (cp >= XID_LIMIT) {\n")
+    out.write("        return cp >= 0xE0100 && cp <= 0xE01EF;\n")
+    out.write("    }\n")
+    out.write("    return bit(XID_LEAVES[XID_INDEX[cp >> 7]].cont, cp);\n")
+    out.write("}\n")
+
+
+if __name__ == "__main__":
+    main()